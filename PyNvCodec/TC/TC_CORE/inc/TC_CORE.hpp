@@ -39,7 +39,12 @@ protected:
   Token();
 };
 
-enum class TaskExecStatus { TASK_EXEC_SUCCESS, TASK_EXEC_FAIL };
+enum class TaskExecStatus {
+  TASK_EXEC_SUCCESS,
+  TASK_EXEC_FAIL,
+  // Blocking I/O call didn't finish in time;
+  TASK_EXEC_TIMEOUT
+};
 
 /* Task is unit of processing; Inherit from this class to add user-defined
  * processing stage;
@@ -0,0 +1,456 @@
+/*
+ * Copyright 2020 NVIDIA Corporation
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/* Demux-only throughput benchmark;
+ * Generates test inputs of several containers, codecs and bitrates (or takes
+ * them from command line), demuxes them through FFmpegDemuxer::Demux and
+ * DemuxFrame::Execute with Annex.B conversion on and off at several
+ * concurrency levels. Results are printed to stdout as JSON;
+ */
+
+#include "FFmpegDemuxer.h"
+#include "Tasks.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+extern "C" {
+#include <libavcodec/avcodec.h>
+#include <libavformat/avformat.h>
+#include <libavutil/opt.h>
+}
+
+using namespace std;
+using namespace VPF;
+
+/* Allocations are counted process-wide;
+ * With glibc every malloc-family call is counted, libav* ones included.
+ * Elsewhere only C++ allocations are;
+ */
+static atomic<uint64_t> numAllocations(0U);
+
+#if defined(__GLIBC__)
+extern "C" {
+void *__libc_malloc(size_t size);
+void *__libc_calloc(size_t num, size_t size);
+void *__libc_realloc(void *ptr, size_t size);
+void *__libc_memalign(size_t alignment, size_t size);
+
+void *malloc(size_t size) {
+  numAllocations++;
+  return __libc_malloc(size);
+}
+
+void *calloc(size_t num, size_t size) {
+  numAllocations++;
+  return __libc_calloc(num, size);
+}
+
+void *realloc(void *ptr, size_t size) {
+  numAllocations++;
+  return __libc_realloc(ptr, size);
+}
+
+void *memalign(size_t alignment, size_t size) {
+  numAllocations++;
+  return __libc_memalign(alignment, size);
+}
+
+void *aligned_alloc(size_t alignment, size_t size) {
+  numAllocations++;
+  return __libc_memalign(alignment, size);
+}
+
+int posix_memalign(void **ptr, size_t alignment, size_t size) {
+  numAllocations++;
+  *ptr = __libc_memalign(alignment, size);
+  return *ptr ? 0 : ENOMEM;
+}
+}
+#else
+void *operator new(size_t size) {
+  numAllocations++;
+  if (auto ptr = malloc(size ? size : 1U)) {
+    return ptr;
+  }
+  throw bad_alloc();
+}
+
+void operator delete(void *ptr) noexcept { free(ptr); }
+#endif
+
+struct Input {
+  string path;
+  string container;
+  string codec;
+  int64_t bitrate = 0;
+};
+
+struct Config {
+  string dir = ".";
+  uint32_t numFrames = 300U;
+  uint32_t width = 1280U;
+  uint32_t height = 720U;
+  vector<uint32_t> threads = {1U, 2U, 4U, 8U};
+  vector<string> files;
+};
+
+static void PrintUsage() {
+  cerr << "Usage: DemuxBenchmark [-d dir] [-n frames] [-s WxH] "
+          "[-t threads,...] [input ...]"
+       << endl;
+}
+
+static vector<uint32_t> ParseList(const string &str) {
+  vector<uint32_t> values;
+  stringstream ss(str);
+  string item;
+  while (getline(ss, item, ',')) {
+    values.push_back(stoul(item));
+  }
+  return values;
+}
+
+static string JsonEscape(const string &str) {
+  string out;
+  for (auto c : str) {
+    if ('"' == c || '\\' == c) {
+      out += '\\';
+    }
+    out += c;
+  }
+  return out;
+}
+
+/* Encodes synthetic video with given encoder and muxes it to file;
+ * Frames are noise over moving gradient, so encoder hits target bitrate;
+ */
+static bool Generate(const Config &config, const string &encoderName,
+                     const Input &input) {
+  auto encoder = avcodec_find_encoder_by_name(encoderName.c_str());
+  if (!encoder) {
+    return false;
+  }
+
+  AVFormatContext *oc = nullptr;
+  avformat_alloc_output_context2(&oc, nullptr, nullptr, input.path.c_str());
+  if (!oc) {
+    return false;
+  }
+
+  auto stream = avformat_new_stream(oc, nullptr);
+  auto ctx = avcodec_alloc_context3(encoder);
+  auto const fps = 30;
+  ctx->width = config.width;
+  ctx->height = config.height;
+  ctx->time_base = av_make_q(1, fps);
+  ctx->framerate = av_make_q(fps, 1);
+  ctx->pix_fmt = AV_PIX_FMT_YUV420P;
+  ctx->bit_rate = input.bitrate;
+  ctx->gop_size = 2 * fps;
+  ctx->max_b_frames = 2;
+  if (oc->oformat->flags & AVFMT_GLOBALHEADER) {
+    ctx->flags |= AV_CODEC_FLAG_GLOBAL_HEADER;
+  }
+
+  auto frame = av_frame_alloc();
+  auto pkt = av_packet_alloc();
+  bool res = (0 == avcodec_open2(ctx, encoder, nullptr)) &&
+             (0 <= avcodec_parameters_from_context(stream->codecpar, ctx)) &&
+             (0 <= avio_open(&oc->pb, input.path.c_str(), AVIO_FLAG_WRITE));
+  stream->time_base = ctx->time_base;
+  res = res && (0 <= avformat_write_header(oc, nullptr));
+
+  frame->format = ctx->pix_fmt;
+  frame->width = ctx->width;
+  frame->height = ctx->height;
+  res = res && (0 == av_frame_get_buffer(frame, 32));
+
+  auto drain = [&]() {
+    while (0 == avcodec_receive_packet(ctx, pkt)) {
+      av_packet_rescale_ts(pkt, ctx->time_base, stream->time_base);
+      pkt->stream_index = stream->index;
+      av_interleaved_write_frame(oc, pkt);
+    }
+  };
+
+  uint32_t seed = 2463534242U;
+  for (uint32_t n = 0U; res && n < config.numFrames; n++) {
+    av_frame_make_writable(frame);
+    for (int plane = 0; plane < 3; plane++) {
+      auto const w = plane ? ctx->width / 2 : ctx->width;
+      auto const h = plane ? ctx->height / 2 : ctx->height;
+      for (int y = 0; y < h; y++) {
+        auto line = frame->data[plane] + y * frame->linesize[plane];
+        for (int x = 0; x < w; x++) {
+          seed ^= seed << 13;
+          seed ^= seed >> 17;
+          seed ^= seed << 5;
+          line[x] = (uint8_t)(x + y + 4 * n + (seed & 0x1F));
+        }
+      }
+    }
+    frame->pts = n;
+    res = (0 == avcodec_send_frame(ctx, frame));
+    drain();
+  }
+
+  if (res) {
+    avcodec_send_frame(ctx, nullptr);
+    drain();
+    av_write_trailer(oc);
+  }
+
+  av_packet_free(&pkt);
+  av_frame_free(&frame);
+  avcodec_free_context(&ctx);
+  avio_closep(&oc->pb);
+  avformat_free_context(oc);
+
+  return res;
+}
+
+struct Result {
+  uint64_t numPackets = 0U;
+  uint64_t numBytes = 0U;
+  uint64_t numAllocations = 0U;
+  double wallTime = 0.0;
+  double cpuTime = 0.0;
+};
+
+/* Every thread demuxes whole input with demuxer of its own;
+ * Demuxers are opened before measurement starts;
+ */
+static Result Run(const Input &input, bool useTask, bool annexb,
+                  uint32_t numThreads) {
+  map<string, string> options = {{"annexb", annexb ? "1" : "0"}};
+
+  vector<unique_ptr<FFmpegDemuxer>> demuxers;
+  vector<unique_ptr<DemuxFrame>> tasks;
+  vector<const char *> taskOptions = {"annexb", annexb ? "1" : "0"};
+  for (uint32_t i = 0U; i < numThreads; i++) {
+    if (useTask) {
+      tasks.emplace_back(DemuxFrame::Make(input.path.c_str(),
+                                          taskOptions.data(),
+                                          taskOptions.size()));
+    } else {
+      demuxers.emplace_back(new FFmpegDemuxer(input.path.c_str(), options));
+    }
+  }
+
+  mutex startMutex;
+  condition_variable startCv;
+  bool isStarted = false;
+  vector<uint64_t> packets(numThreads, 0U), bytes(numThreads, 0U);
+
+  auto work = [&](uint32_t idx) {
+    {
+      unique_lock<mutex> lock(startMutex);
+      startCv.wait(lock, [&]() { return isStarted; });
+    }
+
+    if (useTask) {
+      auto task = tasks[idx].get();
+      while (TASK_EXEC_SUCCESS == task->Execute()) {
+        auto pBuffer = (Buffer *)task->GetOutput(0U);
+        if (pBuffer) {
+          packets[idx]++;
+          bytes[idx] += pBuffer->GetRawMemSize();
+        }
+      }
+    } else {
+      uint8_t *pVideo = nullptr;
+      size_t videoBytes = 0U;
+      while (demuxers[idx]->Demux(pVideo, videoBytes)) {
+        packets[idx]++;
+        bytes[idx] += videoBytes;
+      }
+    }
+  };
+
+  vector<thread> workers;
+  for (uint32_t i = 0U; i < numThreads; i++) {
+    workers.emplace_back(work, i);
+  }
+
+  Result result;
+  auto const allocsBefore = numAllocations.load();
+  auto const cpuBefore = clock();
+  auto const wallBefore = chrono::steady_clock::now();
+  {
+    lock_guard<mutex> lock(startMutex);
+    isStarted = true;
+  }
+  startCv.notify_all();
+
+  for (auto &worker : workers) {
+    worker.join();
+  }
+
+  result.wallTime =
+      chrono::duration<double>(chrono::steady_clock::now() - wallBefore)
+          .count();
+  result.cpuTime = (double)(clock() - cpuBefore) / CLOCKS_PER_SEC;
+  result.numAllocations = numAllocations.load() - allocsBefore;
+  for (uint32_t i = 0U; i < numThreads; i++) {
+    result.numPackets += packets[i];
+    result.numBytes += bytes[i];
+  }
+
+  return result;
+}
+
+int main(int argc, char *argv[]) {
+  Config config;
+  try {
+    for (int i = 1; i < argc; i++) {
+      string arg(argv[i]);
+      auto hasValue = (i + 1 < argc);
+      if ("-d" == arg && hasValue) {
+        config.dir = argv[++i];
+      } else if ("-n" == arg && hasValue) {
+        config.numFrames = stoul(argv[++i]);
+      } else if ("-s" == arg && hasValue) {
+        string res(argv[++i]);
+        auto pos = res.find('x');
+        config.width = stoul(res.substr(0, pos));
+        config.height = stoul(res.substr(pos + 1));
+      } else if ("-t" == arg && hasValue) {
+        config.threads = ParseList(argv[++i]);
+      } else if ('-' == arg[0]) {
+        PrintUsage();
+        return 1;
+      } else {
+        config.files.push_back(arg);
+      }
+    }
+  } catch (exception &e) {
+    PrintUsage();
+    return 1;
+  }
+
+  av_log_set_level(AV_LOG_ERROR);
+
+  vector<Input> inputs;
+  stringstream skipped;
+  if (!config.files.empty()) {
+    for (auto &file : config.files) {
+      Input input;
+      input.path = file;
+      inputs.push_back(input);
+    }
+  } else {
+    struct Codec {
+      string name;
+      vector<string> encoders;
+    };
+    vector<Codec> codecs = {{"h264", {"h264_nvenc", "libx264"}},
+                            {"hevc", {"hevc_nvenc", "libx265"}},
+                            {"mpeg4", {"mpeg4"}}};
+    vector<string> containers = {"mp4", "mkv", "ts"};
+    vector<int64_t> bitrates = {1000000, 8000000, 32000000};
+
+    for (auto &codec : codecs) {
+      for (auto &container : containers) {
+        for (auto bitrate : bitrates) {
+          Input input;
+          input.container = container;
+          input.codec = codec.name;
+          input.bitrate = bitrate;
+          input.path = config.dir + "/bench_" + codec.name + "_" +
+                       to_string(bitrate / 1000) + "k." + container;
+
+          bool isGenerated = false;
+          for (auto &encoder : codec.encoders) {
+            if ((isGenerated = Generate(config, encoder, input))) {
+              break;
+            }
+          }
+
+          if (isGenerated) {
+            inputs.push_back(input);
+          } else {
+            skipped << (skipped.tellp() ? ",\n" : "") << "    {\"file\": \""
+                    << JsonEscape(input.path)
+                    << "\", \"reason\": \"can't encode\"}";
+          }
+        }
+      }
+    }
+  }
+
+  cout << "{\n  \"results\": [";
+  bool isFirst = true;
+  for (auto &input : inputs) {
+    for (auto useTask : {false, true}) {
+      for (auto annexb : {true, false}) {
+        for (auto numThreads : config.threads) {
+          Result result;
+          try {
+            result = Run(input, useTask, annexb, numThreads);
+          } catch (exception &e) {
+            cerr << input.path << ": " << e.what() << endl;
+            continue;
+          }
+
+          auto const numPackets = max<uint64_t>(result.numPackets, 1U);
+          auto const wallTime = max(result.wallTime, 1e-9);
+
+          cout << (isFirst ? "\n" : ",\n") << "    {";
+          cout << "\"file\": \"" << JsonEscape(input.path) << "\", ";
+          cout << "\"container\": \"" << input.container << "\", ";
+          cout << "\"codec\": \"" << input.codec << "\", ";
+          cout << "\"bitrate\": " << input.bitrate << ", ";
+          cout << "\"api\": \"" << (useTask ? "DemuxFrame" : "FFmpegDemuxer")
+               << "\", ";
+          cout << "\"annexb\": " << (annexb ? "true" : "false") << ", ";
+          cout << "\"threads\": " << numThreads << ", ";
+          cout << "\"packets\": " << result.numPackets << ", ";
+          cout << "\"bytes\": " << result.numBytes << ", ";
+          cout << "\"seconds\": " << result.wallTime << ", ";
+          cout << "\"packets_per_second\": " << result.numPackets / wallTime
+               << ", ";
+          cout << "\"mb_per_second\": " << result.numBytes / wallTime / 1e6
+               << ", ";
+          cout << "\"allocations_per_packet\": "
+               << (double)result.numAllocations / numPackets << ", ";
+          cout << "\"cpu_us_per_packet\": "
+               << result.cpuTime * 1e6 / numPackets << "}";
+          isFirst = false;
+        }
+      }
+    }
+  }
+  cout << "\n  ],\n  \"skipped\": [";
+  if (skipped.tellp()) {
+    cout << "\n" << skipped.str() << "\n  ";
+  }
+  cout << "]\n}" << endl;
+
+  return 0;
+}
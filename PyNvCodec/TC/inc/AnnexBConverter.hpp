@@ -0,0 +1,60 @@
+/*
+ * Copyright 2020 NVIDIA Corporation
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace VPF {
+
+/* Converts H.264 / HEVC packets with NAL unit length prefixes (as stored in
+ * MP4, MKV etc.) to Annex.B format with start codes;
+ * Does the same job as h264_mp4toannexb and hevc_mp4toannexb bitstream
+ * filters but writes straight to caller's buffer and doesn't allocate;
+ */
+class AnnexBConverter {
+public:
+  /* Parses codec extradata;
+   * If it's Annex.B already or missing, packets are passed through as is;
+   */
+  void Init(const uint8_t *extradata, size_t size, bool isHEVC);
+
+  /* Parses extradata which changed on the fly;
+   * Previous state is kept unless new extradata has NAL unit length size,
+   * returns false then;
+   */
+  bool Update(const uint8_t *extradata, size_t size);
+
+  /* Appends converted packet to output;
+   * Parameter sets from extradata are inserted before IDR / IRAP pictures
+   * unless packet has them in-band;
+   * Returns false if packet is malformed, output is left intact then;
+   */
+  bool Convert(const uint8_t *data, size_t size,
+               std::vector<uint8_t> &output) const;
+
+  bool IsPassthrough() const { return 0U == nalLengthSize; }
+
+  uint32_t NalLengthSize() const { return nalLengthSize; }
+
+private:
+  bool isHEVC = false;
+  uint32_t nalLengthSize = 0U;
+
+  // Parameter sets from extradata, in Annex.B format;
+  std::vector<uint8_t> paramSets;
+};
+
+} // namespace VPF
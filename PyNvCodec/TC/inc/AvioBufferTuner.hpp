@@ -0,0 +1,70 @@
+/*
+ * Copyright 2020 NVIDIA Corporation
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+
+extern "C" {
+#include <libavformat/avformat.h>
+}
+
+namespace VPF {
+
+/* Sizes AVIO buffer of demuxer input;
+ * Every buffer refill is a single read from underlying protocol or data
+ * provider, so buffer size is both readahead and memory footprint of input;
+ * In adaptive mode buffer is sized to hold given duration of media, derived
+ * from observed bitrate. It's grown further if refills are slow, as fewer
+ * larger reads pay off on high latency storage;
+ */
+class AvioBufferTuner {
+public:
+  static const uint32_t minBufferSize = 32U * 1024U;
+
+  void Configure(bool adaptive, uint32_t maxBufferSize, double bufferDuration);
+
+  // Forgets observed bitrate and latency, e. g. when input is reopened;
+  void Reset();
+
+  // Call around every av_read_frame();
+  void BeginRead(AVIOContext *pb);
+  void EndRead(AVIOContext *pb, int64_t ts, double timeBase);
+
+  /* Replaces AVIO buffer with one of given size;
+   * Unread data is moved to new buffer, so it's safe between reads;
+   */
+  static bool Resize(AVIOContext *pb, uint32_t newSize);
+
+private:
+  void Update(AVIOContext *pb);
+
+  bool adaptive = false;
+  uint32_t maxBufferSize = 16U * 1024U * 1024U;
+  double bufferDuration = 1.0;
+
+  // Media time and input position at first and last timestamped packet;
+  bool hasFirst = false;
+  double firstTs = 0.0;
+  double lastTs = 0.0;
+  int64_t firstPos = 0;
+
+  int64_t posBefore = 0;
+  std::chrono::steady_clock::time_point readStart;
+
+  uint32_t numRefills = 0U;
+  double refillTime = 0.0;
+};
+
+} // namespace VPF
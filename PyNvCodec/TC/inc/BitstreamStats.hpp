@@ -0,0 +1,88 @@
+/*
+ * Copyright 2020 NVIDIA Corporation
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include "FFmpegDemuxer.h"
+#include <cstdint>
+#include <vector>
+
+/* Video bitstream statistics which are gathered from packets only;
+ * Sizes are given in bytes, times in seconds, bitrates in bits per second;
+ */
+struct BitstreamStats {
+  uint64_t numPackets = 0U;
+  uint64_t numKeyframes = 0U;
+  uint64_t totalBytes = 0U;
+  double duration = 0.0;
+
+  double avgBitrate = 0.0;
+  double maxBitrate = 0.0;
+
+  // GOP size in packets, trailing incomplete GOP included;
+  uint32_t minGopSize = 0U;
+  uint32_t maxGopSize = 0U;
+  double avgGopSize = 0.0;
+
+  // Distance between adjacent keyframes;
+  double minKeyframeInterval = 0.0;
+  double maxKeyframeInterval = 0.0;
+  double avgKeyframeInterval = 0.0;
+
+  // Frame types are taken from slice headers, H.264 / HEVC only;
+  uint64_t numIDR = 0U;
+  uint64_t numI = 0U;
+  uint64_t numP = 0U;
+  uint64_t numB = 0U;
+  uint32_t maxConsecutiveB = 0U;
+
+  // Bitrate of consecutive windows of given length;
+  double window = 1.0;
+  std::vector<double> bitrate;
+
+  std::vector<uint32_t> gopSizes;
+
+  // Bin #i counts packets which are [2^i, 2^(i+1)) bytes large;
+  std::vector<uint64_t> sizeHistogram;
+};
+
+/* Updates statistics packet by packet in single streaming pass;
+ * Memory use doesn't depend on number of packets other than through
+ * bitrate and GOP sizes arrays;
+ */
+class DllExport BitstreamStatsCollector {
+public:
+  BitstreamStatsCollector(double timeBase, double window = 1.0);
+
+  void Add(const PacketData &packetData, size_t packetSize);
+
+  // Completes last GOP and averages;
+  const BitstreamStats &Finish();
+
+  // Demuxes all video packets left in input and gathers statistics;
+  static BitstreamStats Collect(FFmpegDemuxer &demuxer, double window = 1.0);
+
+private:
+  BitstreamStats stats;
+  double timeBase;
+
+  int64_t firstTs;
+  int64_t lastTs;
+  int64_t lastDuration = 0;
+  int64_t firstKeyTs;
+  int64_t lastKeyTs;
+
+  uint32_t gopSize = 0U;
+  uint32_t numConsecutiveB = 0U;
+  bool isFinished = false;
+};
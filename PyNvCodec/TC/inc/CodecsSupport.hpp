@@ -13,6 +13,7 @@
 
 #pragma once
 #include "MemoryInterfaces.hpp"
+#include "NalParser.hpp"
 #include "cuviddec.h"
 #include <stdint.h>
 
@@ -21,6 +22,58 @@ struct PacketData {
   int64_t dts;
   uint64_t pos;
   uint64_t duration;
+  // AV_PKT_FLAG_* bit mask;
+  uint32_t flags;
+
+  /* Bitstream info taken from NAL unit headers and first slice header;
+   * H.264 and HEVC only, zeroes otherwise;
+   */
+  // Bit mask of NAL unit types found in packet;
+  uint64_t nalTypes;
+  VPF::SliceType sliceType;
+  // Highest nal_ref_idc among slices, H.264 only;
+  uint32_t nalRefIdc;
+  // Lowest temporal id among slices, HEVC only;
+  uint32_t temporalId;
+  bool isIDR;
+  bool isReference;
+  bool hasVPS;
+  bool hasSPS;
+  bool hasPPS;
+};
+
+/* Describes single packet within batch of packets stored back to back;
+ * Offset is given in bytes from the beginning of batch;
+ */
+struct PacketBatchEntry {
+  uint64_t offset;
+  uint64_t size;
+  int64_t pts;
+  int64_t dts;
+  uint64_t duration;
+  // AV_PKT_FLAG_* bit mask;
+  uint32_t flags;
+};
+
+/* Describes decoded frame;
+ * Timestamps are given in stream time base, which is
+ * time_base_num / time_base_den seconds;
+ */
+struct FrameMetadata {
+  int64_t pts;
+  int64_t pkt_dts;
+  int64_t best_effort_timestamp;
+  int64_t duration;
+  int32_t time_base_num;
+  int32_t time_base_den;
+  uint32_t width;
+  uint32_t height;
+  // AVPictureType, e. g. 1 for I, 2 for P and 3 for B frames;
+  uint32_t pict_type;
+  int32_t repeat_pict;
+  uint32_t key_frame;
+  uint32_t interlaced_frame;
+  uint32_t top_field_first;
 };
 
 struct VideoContext {
@@ -35,7 +88,16 @@ struct VideoContext {
 };
 
 struct AudioContext {
-  // Reserved for future use;
+  uint32_t streamIndex;
+  // AVCodecID value;
+  uint32_t codecId;
+  // AVSampleFormat value;
+  int32_t sampleFormat;
+  uint32_t sampleRate;
+  uint32_t numChannels;
+  uint64_t channelLayout;
+  double timeBase;
+  PacketData packetData;
 };
 
 struct MuxingParams {
@@ -0,0 +1,59 @@
+/*
+ * Copyright 2020 NVIDIA Corporation
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include "FFmpegDemuxer.h"
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/* Keeps idle demuxers and rebinds them to new inputs;
+ * Meant for workloads with many short inputs where demuxer construction
+ * takes noticeable share of time. All demuxers share same options;
+ * Thread-safe;
+ */
+class DllExport DemuxerPool {
+public:
+  explicit DemuxerPool(const std::map<std::string, std::string> &ffmpeg_options,
+                       size_t maxIdle = 8U);
+  ~DemuxerPool();
+
+  /* Returns demuxer bound to given input;
+   * Idle demuxer is reused if there's any, new one is created otherwise.
+   * Demuxer is linked to given interrupt handler, see LinkInterrupt().
+   * Idle one is given up for new one only if parameters it inherited from
+   * previous input don't fit, other errors are thrown;
+   */
+  FFmpegDemuxer *Acquire(const char *szFilePath,
+                         const VPF::InterruptHandler *parentInterrupt = nullptr);
+
+  /* Gives demuxer back to pool;
+   * Input is closed and interrupt handler is unlinked. Demuxer is deleted if
+   * pool has enough idle ones;
+   */
+  void Release(FFmpegDemuxer *pDemuxer);
+
+  size_t GetNumIdle() const;
+
+  const std::map<std::string, std::string> &GetOptions() const;
+
+private:
+  std::map<std::string, std::string> options;
+  size_t maxIdle;
+
+  mutable std::mutex poolMutex;
+  std::vector<std::unique_ptr<FFmpegDemuxer>> idle;
+};
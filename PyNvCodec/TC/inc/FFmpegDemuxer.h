@@ -25,22 +25,133 @@ extern "C" {
 #include "libavformat/avio.h"
 }
 
+#include "AnnexBConverter.hpp"
+#include "AvioBufferTuner.hpp"
 #include "CodecsSupport.hpp"
+#include "GopCache.hpp"
+#include "InterruptHandler.hpp"
 #include "NvCodecUtils.h"
 #include "cuviddec.h"
+#include <deque>
 #include <map>
+#include <memory>
 #include <string>
 #include <vector>
 
-class DataProvider;
+/* Source of input bytes for demuxers which don't read from URL;
+ */
+class DllExport DataProvider {
+public:
+  virtual ~DataProvider() = default;
+  virtual int GetData(uint8_t *pBuf, int nBuf) = 0;
+
+  // Seek() is only called for seekable providers;
+  virtual bool IsSeekable() const { return false; }
+
+  /* Same semantics as AVIOContext seek callback, AVSEEK_SIZE included;
+   * Returns new position or negative value on error;
+   */
+  virtual int64_t Seek(int64_t, int) { return -1; }
+};
+
+enum PacketFilterMode {
+  // All video packets are returned;
+  FILTER_NONE = 0,
+  // Keyframes only;
+  FILTER_KEYFRAMES = 1,
+  // Every Nth keyframe;
+  FILTER_NTH_KEYFRAME = 2,
+  // First keyframe after every time stride;
+  FILTER_TIME_STRIDE = 3,
+};
+
+/* Video packets selection;
+ * Unless mode is FILTER_NONE, demuxer uses container index (if any) to seek
+ * from one selected keyframe to another so non-selected data isn't read;
+ */
+struct PacketFilter {
+  PacketFilterMode mode = FILTER_NONE;
+  uint32_t keyframeStep = 1U;
+  // Time stride in seconds;
+  double timeStride = 0.0;
+};
+
+/* Demuxer settings which are handled by VPF itself;
+ * They are given alongside FFmpeg options and never reach libavformat;
+ */
+struct DemuxerSettings {
+  /* Don't probe streams if container headers, SPS or cached parameters give
+   * enough information about video stream;
+   */
+  bool fastOpen = false;
+
+  // Caller-supplied video stream parameters, used by fast open only;
+  AVCodecID cachedCodec = AV_CODEC_ID_NONE;
+  uint32_t cachedWidth = 0U;
+  uint32_t cachedHeight = 0U;
+  double cachedFramerate = 0.0;
+
+  PacketFilter packetFilter;
+
+  // Convert length-prefixed H.264 / HEVC to Annex.B;
+  bool annexb = true;
+
+  // Fill bitstream info in packet data, H.264 / HEVC only;
+  bool nalInfo = true;
+
+  /* Comma-separated list of non-video streams to demux alongside video;
+   * Entries are stream indices or "audio" which stands for all audio streams;
+   */
+  std::string streams;
+
+  // Packets beyond this limit are dropped from stream queue, oldest first;
+  uint32_t maxQueuedPackets = 1024U;
+
+  /* Deadlines in seconds for opening input (streams probing included) and
+   * for every demux call. Zero means no deadline;
+   */
+  double openTimeout = 0.0;
+  double readTimeout = 0.0;
+
+  /* AVIO buffer size in bytes, every refill reads that much at once;
+   * Zero means libavformat default for URLs and 8 MB for data providers;
+   */
+  uint32_t avioBufferSize = 0U;
+
+  /* Resize AVIO buffer to hold avioBufferDuration seconds of media, grow it
+   * further on slow reads. Buffer never exceeds avioMaxBufferSize;
+   */
+  bool avioAdaptive = false;
+  uint32_t avioMaxBufferSize = 16U * 1024U * 1024U;
+  double avioBufferDuration = 1.0;
+
+  /* Read local files through shared io_uring instance;
+   * Needs USE_IO_URING build option, ignored otherwise;
+   */
+  bool ioUring = false;
+
+  /* Byte budget of shared GOP cache, zero disables caching;
+   * Only inputs opened by URL are cached. Packet filter and non-video
+   * streams bypass the cache;
+   */
+  size_t gopCacheSize = 0U;
+};
+
+/* Packets which were read from container ahead of time as another stream
+ * was requested;
+ */
+struct StreamQueue {
+  std::deque<AVPacket *> packets;
+  PacketData lastPacketData;
+};
 
 class DllExport FFmpegDemuxer {
   AVIOContext *avioc = nullptr;
-  AVBSFContext *bsfc = nullptr;
+  // Data provider which AVIO context reads from;
+  DataProvider *avioProvider = nullptr;
   AVFormatContext *fmtc = nullptr;
 
   AVPacket pkt;
-  AVPacket pktFiltered;
   PacketData lastPacketData;
   AVCodecID eVideoCodec = AV_CODEC_ID_NONE;
   AVPixelFormat eChromaFormat;
@@ -52,13 +163,82 @@ class DllExport FFmpegDemuxer {
 
   int videoStream = -1;
 
-  bool is_mp4H264;
-  bool is_mp4HEVC;
+  bool isNalStream = false;
+  bool isAnnexBNeeded = false;
   bool is_EOF = false;
 
+  VPF::AnnexBConverter annexbConverter;
+  VPF::NalParser nalParser;
+  VPF::InterruptHandler interruptHandler;
+  VPF::AvioBufferTuner avioTuner;
+
+  // Packet filter state;
+  uint32_t keyframeCounter = 0U;
+  int64_t lastSelectedTs;
+  int64_t pendingSeekTs;
+
   std::vector<uint8_t> videoBytes;
 
-  explicit FFmpegDemuxer(AVFormatContext *fmtcx);
+  DemuxerSettings settings;
+
+  // Data provider created by demuxer itself, e. g. for io_uring reads;
+  std::unique_ptr<DataProvider> ownProvider;
+
+  // Cached parameters are taken from previous input on reopening;
+  bool inheritCachedParams = true;
+
+  // Options which are passed to libavformat, kept for reopening;
+  std::map<std::string, std::string> avOptions;
+
+  // Queues of video and selected non-video streams, by stream index;
+  std::map<int, StreamQueue> streamQueues;
+  std::vector<int> extraStreams;
+  AVPacket streamPkt;
+
+  // Packets read by fast open while looking for in-band SPS;
+  std::vector<AVPacket *> probedPackets;
+
+  /* GOP cache key, empty if input isn't cacheable;
+   * GOP which is being demuxed is recorded, GOP found in cache on seek is
+   * replayed instead of reading from container;
+   */
+  std::string cacheSource;
+  std::shared_ptr<CachedGop> recordedGop;
+  int64_t recordedKeyPts = AV_NOPTS_VALUE;
+  std::shared_ptr<const CachedGop> replayedGop;
+  size_t replayedPacket = 0U;
+  // Packets before this keyframe are dropped once replay is over;
+  int64_t resumePts = AV_NOPTS_VALUE;
+
+  void Init(AVFormatContext *fmtcx);
+
+  bool DemuxPacket();
+
+  bool IsCacheable() const;
+
+  bool ReplayPacket();
+
+  void RecordPacket(size_t packetOffset);
+
+  void FinishRecording(int64_t endPts, bool isLast);
+
+  bool ReadStreamPacket(int streamIndex, AVPacket &packet);
+
+  void SelectStreams();
+
+  void FlushStreamQueues();
+
+  bool IsSelected(const AVPacket &packet);
+
+  void ScheduleSeekToNextSelected(const AVPacket &packet);
+
+  bool FastOpen();
+
+  bool FindInbandSps(int streamIndex, bool isHEVC, VPF::SpsInfo &spsInfo);
+
+  void QueueProbedPackets();
+
+  void InheritCachedParams();
 
   AVFormatContext *
   CreateFormatContext(DataProvider *pDataProvider,
@@ -69,14 +249,31 @@ class DllExport FFmpegDemuxer {
                       const std::map<std::string, std::string> &ffmpeg_options);
 
 public:
+  // Parent interrupt handler aborts opening as well, see LinkInterrupt();
   explicit FFmpegDemuxer(
       const char *szFilePath,
-      const std::map<std::string, std::string> &ffmpeg_options);
+      const std::map<std::string, std::string> &ffmpeg_options,
+      const VPF::InterruptHandler *parentInterrupt = nullptr);
   explicit FFmpegDemuxer(
       DataProvider *pDataProvider,
       const std::map<std::string, std::string> &ffmpeg_options);
   ~FFmpegDemuxer();
 
+  /* Binds demuxer to new input with same options;
+   * AVFormatContext is allocated anew. Local files are read through own
+   * AVIO context which keeps its buffer. In fast-open mode parameters of
+   * previous input are fallback for the new one, so streams probing is
+   * skipped unless container or SPS tell otherwise;
+   */
+  void Reopen(const char *szFilePath);
+  void Reopen(DataProvider *pDataProvider);
+
+  // Tells if fast open relies on parameters of previous input;
+  bool HasInheritedParams() const;
+
+  // Closes input, demuxer may be reopened afterwards;
+  void Close();
+
   AVCodecID GetVideoCodec() const;
 
   uint32_t GetWidth() const;
@@ -91,11 +288,59 @@ public:
 
   AVPixelFormat GetPixelFormat() const;
 
+  /* Video stream start time in seconds, returns false if it's unknown;
+   * Other streams aren't accounted for, unlike container start time;
+   */
+  bool GetStartTime(double &startTime) const;
+
   bool Demux(uint8_t *&pVideo, size_t &rVideoBytes);
 
+  /* Demuxes up to maxPackets video packets and stores them back to back;
+   * Stops as soon as maxBytes is reached, so last packet may go beyond it;
+   * Returns false if no packets were demuxed;
+   */
+  bool DemuxBatch(uint32_t maxPackets, size_t maxBytes, uint8_t *&pVideo,
+                  size_t &rVideoBytes, std::vector<PacketBatchEntry> &entries);
+
   void GetLastPacketData(PacketData &pktData);
 
+  // Non-video streams selected with "streams" option;
+  const std::vector<int> &GetExtraStreams() const;
+
+  /* Demuxes next packet of selected non-video stream;
+   * Packets of other selected streams which are read meanwhile are queued, so
+   * every byte is read from container once;
+   */
+  bool DemuxStream(int streamIndex, uint8_t *&pData, size_t &rBytes);
+
+  // Returns false if stream isn't selected;
+  bool GetAudioContext(int streamIndex, AudioContext &audioContext) const;
+
+  void SetPacketFilter(const PacketFilter &filter);
+
+  /* Seeks video stream to keyframe at or before given timestamp;
+   * Timestamp is given in seconds, in same timeline as packet timestamps;
+   */
+  bool Seek(double timestamp);
+
+  /* Aborts blocking I/O call which is in progress and all following ones,
+   * until demuxer is reopened. Thread-safe;
+   */
+  void Interrupt();
+
+  // I/O is aborted while given handler is interrupted, nullptr unlinks;
+  void LinkInterrupt(const VPF::InterruptHandler *parent);
+
+  // Tells if last demux call has failed because of read timeout;
+  bool IsTimedOut() const;
+
+  // Current AVIO buffer size in bytes, zero if input has no AVIO context;
+  size_t GetAvioBufferSize() const;
+
+  // AVIO callbacks, opaque is demuxer. Interrupt and timeouts are honoured;
   static int ReadPacket(void *opaque, uint8_t *pBuf, int nBuf);
+
+  static int64_t SeekPacket(void *opaque, int64_t offset, int whence);
 };
 
 inline cudaVideoCodec FFmpeg2NvCodecId(AVCodecID id) {
@@ -0,0 +1,42 @@
+/*
+ * Copyright 2020 NVIDIA Corporation
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include "FFmpegDemuxer.h"
+#include <cstdio>
+
+/* Reads local file with plain unbuffered stdio;
+ * Demuxer reads through its own AVIO context on top of it, so AVIO buffer
+ * outlives the file and is reused when demuxer is reopened;
+ */
+class DllExport FileDataProvider final : public DataProvider {
+public:
+  explicit FileDataProvider(const char *szFilePath);
+  ~FileDataProvider() final;
+
+  FileDataProvider(const FileDataProvider &other) = delete;
+  FileDataProvider &operator=(const FileDataProvider &other) = delete;
+
+  int GetData(uint8_t *pBuf, int nBuf) final;
+  bool IsSeekable() const final { return true; }
+  int64_t Seek(int64_t offset, int whence) final;
+
+  // True for paths which libavformat would open with its file protocol;
+  static bool IsLocalFile(const char *szFilePath);
+
+private:
+  FILE *file = nullptr;
+  int64_t fileSize = 0;
+  int64_t position = 0;
+};
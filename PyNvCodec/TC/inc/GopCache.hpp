@@ -0,0 +1,96 @@
+/*
+ * Copyright 2020 NVIDIA Corporation
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include "CodecsSupport.hpp"
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#if defined(_WIN32)
+#define DllExport __declspec(dllexport)
+#else
+#define DllExport
+#endif
+
+/* Video packets of single GOP as they are given to user, keyframe first;
+ * Packet #i occupies [offsets[i], offsets[i] + sizes[i]) of data;
+ */
+struct CachedGop {
+  std::vector<uint8_t> data;
+  std::vector<size_t> offsets;
+  std::vector<size_t> sizes;
+  std::vector<PacketData> packets;
+
+  // Pts of keyframe which follows the GOP, unless it's the last one;
+  int64_t endPts = 0;
+  bool isLast = false;
+
+  size_t SizeInBytes() const;
+};
+
+/* LRU cache of demuxed GOPs, keyed by source and keyframe pts;
+ * Demuxers which are given "gop_cache_size" option share single instance,
+ * so hot regions of input are kept in memory across demuxers and reopening.
+ * Seek into cached GOP doesn't touch the container. Thread-safe;
+ */
+class DllExport GopCache {
+public:
+  explicit GopCache(size_t byteBudget);
+
+  GopCache(const GopCache &other) = delete;
+  GopCache &operator=(const GopCache &other) = delete;
+
+  // Budget of shared instance is the largest one requested so far;
+  static GopCache &GetShared();
+
+  void SetByteBudget(size_t byteBudget);
+  size_t GetByteBudget() const;
+
+  // Total size of cached GOPs in bytes;
+  size_t GetSize() const;
+
+  // GOPs which don't fit into budget on their own aren't cached;
+  void Insert(const std::string &source, int64_t keyPts,
+              std::shared_ptr<const CachedGop> gop);
+
+  // Returns GOP which covers given pts or nullptr;
+  std::shared_ptr<const CachedGop> Find(const std::string &source,
+                                        int64_t pts);
+
+  void Clear();
+
+private:
+  void Evict();
+
+  using Key = std::pair<std::string, int64_t>;
+
+  struct Entry {
+    std::shared_ptr<const CachedGop> gop;
+    std::list<Key>::iterator lruPos;
+  };
+
+  // Most recently used GOPs go first;
+  std::list<Key> lru;
+
+  // GOPs by source, then by keyframe pts;
+  std::map<std::string, std::map<int64_t, Entry>> entries;
+
+  size_t budget;
+  size_t size = 0U;
+  mutable std::mutex cacheMutex;
+};
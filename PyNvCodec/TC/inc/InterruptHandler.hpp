@@ -0,0 +1,78 @@
+/*
+ * Copyright 2020 NVIDIA Corporation
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <stdexcept>
+#include <string>
+
+extern "C" {
+#include <libavformat/avformat.h>
+}
+
+namespace VPF {
+
+class TimeoutException : public std::runtime_error {
+public:
+  TimeoutException(const std::string &str) : std::runtime_error(str) {}
+  TimeoutException() : std::runtime_error("I/O timeout") {}
+};
+
+/* Aborts blocking libavformat calls through AVFormatContext interrupt
+ * callback;
+ * Deadline is armed by the thread which makes blocking call. Interrupt() may
+ * be called from any thread and cancels all following calls as well;
+ * libavformat doesn't check interrupt callback while reading from custom
+ * AVIO contexts, so their callbacks have to call Callback() themselves;
+ */
+class InterruptHandler {
+public:
+  // Installs interrupt callback to given context;
+  void Install(AVFormatContext *ctx);
+
+  // Timeout is given in seconds, non-positive value means no deadline;
+  void Arm(double timeout);
+  void Disarm();
+
+  void Interrupt();
+
+  // Clears interruption so that handler may be used again;
+  void Reset() { interrupted.store(false); }
+
+  /* Calls are also aborted while parent handler is interrupted, e. g. for
+   * demuxers which are opened on behalf of another one. Parent has to
+   * outlive the link, nullptr unlinks;
+   */
+  void Link(const InterruptHandler *newParent) { parent.store(newParent); }
+
+  bool IsInterrupted() const {
+    auto p = parent.load();
+    return interrupted.load() || (p && p->IsInterrupted());
+  }
+
+  // Tells if deadline has passed since last Arm();
+  bool IsTimedOut() const { return timedOut; }
+
+  static int Callback(void *opaque);
+
+private:
+  std::atomic<bool> interrupted{false};
+  std::atomic<const InterruptHandler *> parent{nullptr};
+  bool isArmed = false;
+  bool timedOut = false;
+  std::chrono::steady_clock::time_point deadline;
+};
+
+} // namespace VPF
@@ -30,6 +30,13 @@ enum Pixel_Format {
   RGB_PLANAR = 5,
   BGR = 6,
   YCBCR = 7,
+  // Planar 4:2:2 and 4:4:4, 8 bit;
+  YUV422 = 8,
+  YUV444 = 9,
+  // Semi-planar 4:2:0, 16 bit little endian samples with 10 MSB set;
+  P10 = 10,
+  // Planar 4:2:0, 16 bit little endian samples with 10 LSB set;
+  YUV420_10bit = 11,
 };
 
 /* Represents CPU-side memory.
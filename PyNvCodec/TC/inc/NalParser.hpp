@@ -0,0 +1,146 @@
+/*
+ * Copyright 2020 NVIDIA Corporation
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace VPF {
+
+/* Reads bits from RBSP (emulation prevention bytes must be removed);
+ * Reading past the end returns zeroes and raises overrun flag;
+ */
+class BitReader {
+public:
+  BitReader(const uint8_t *data, size_t size);
+
+  uint32_t ReadBits(uint32_t numBits);
+  uint32_t ReadBit() { return ReadBits(1U); }
+  void SkipBits(size_t numBits);
+
+  // Exp-Golomb codes;
+  uint32_t ReadUE();
+  int32_t ReadSE();
+
+  bool Overrun() const { return overrun; }
+
+private:
+  const uint8_t *pData;
+  size_t sizeInBits;
+  size_t bitPos = 0U;
+  bool overrun = false;
+};
+
+/* Returns pointer to first 00 00 01 start code within [p, end) or end if
+ * there's none. Uses SSE2 to skip over non-zero bytes where available;
+ */
+const uint8_t *FindStartCode(const uint8_t *p, const uint8_t *end);
+
+/* Converts NAL unit payload to RBSP by removing emulation prevention bytes;
+ */
+void NalToRbsp(const uint8_t *nal, size_t size, std::vector<uint8_t> &rbsp);
+
+/* Parameter sets extracted from codec extradata (avcC, hvcC or Annex.B);
+ * Every entry is a single NAL unit without start code or length prefix;
+ */
+struct ParameterSets {
+  std::vector<std::vector<uint8_t>> vps;
+  std::vector<std::vector<uint8_t>> sps;
+  std::vector<std::vector<uint8_t>> pps;
+
+  // Size of NAL unit length prefix, 0 for Annex.B extradata;
+  uint32_t nalLengthSize = 0U;
+};
+
+bool ParseExtradata(const uint8_t *data, size_t size, bool isHEVC,
+                    ParameterSets &paramSets);
+
+/* Stream properties which can be derived from SPS;
+ * Frame rate is zero if SPS has no VUI timing info;
+ */
+struct SpsInfo {
+  uint32_t width = 0U;
+  uint32_t height = 0U;
+  uint32_t chromaFormatIdc = 1U;
+  uint32_t bitDepthLuma = 8U;
+  double frameRate = 0.0;
+};
+
+// NAL unit given without start code, header bytes included;
+bool ParseH264Sps(const uint8_t *nal, size_t size, SpsInfo &info);
+
+// NAL unit given without start code, header bytes included;
+bool ParseHEVCSps(const uint8_t *nal, size_t size, SpsInfo &info);
+
+enum SliceType {
+  SLICE_TYPE_UNKNOWN = 0,
+  SLICE_TYPE_I = 1,
+  SLICE_TYPE_P = 2,
+  SLICE_TYPE_B = 3,
+};
+
+/* Access unit properties which can be told from NAL headers and first slice
+ * header without decoding;
+ */
+struct AccessUnitInfo {
+  // Bit mask of NAL unit types found in access unit;
+  uint64_t nalTypes = 0U;
+  // Type of first slice;
+  SliceType sliceType = SLICE_TYPE_UNKNOWN;
+  // Highest nal_ref_idc among slices, H.264 only;
+  uint32_t nalRefIdc = 0U;
+  // Lowest temporal id among slices, HEVC only;
+  uint32_t temporalId = 0U;
+  bool isIDR = false;
+  bool isReference = false;
+  bool hasVPS = false;
+  bool hasSPS = false;
+  bool hasPPS = false;
+};
+
+/* Lightweight H.264 / HEVC parser;
+ * Looks into NAL unit headers and first slice header only. Keeps track of
+ * PPS as HEVC slice header layout depends on it;
+ */
+class NalParser {
+public:
+  explicit NalParser(bool isHEVC = false);
+
+  /* Takes parameter sets from codec extradata, as they aren't necessarily
+   * repeated in-band;
+   */
+  bool SetExtradata(const uint8_t *data, size_t size);
+
+  void ParseAnnexB(const uint8_t *data, size_t size, AccessUnitInfo &info);
+
+  void ParseLengthPrefixed(const uint8_t *data, size_t size,
+                           uint32_t nalLengthSize, AccessUnitInfo &info);
+
+private:
+  void ParseNal(const uint8_t *nal, size_t size, AccessUnitInfo &info);
+  void ParseH264Nal(const uint8_t *nal, size_t size, AccessUnitInfo &info);
+  void ParseHEVCNal(const uint8_t *nal, size_t size, AccessUnitInfo &info);
+  void ParseHEVCPps(const uint8_t *nal, size_t size);
+
+  bool isHEVC;
+  bool hasSlice = false;
+  std::vector<uint8_t> rbsp;
+
+  // HEVC PPS fields needed to parse slice header, indexed by PPS id;
+  static const uint32_t maxHEVCPps = 64U;
+  uint8_t extraSliceHeaderBits[maxHEVCPps] = {0};
+};
+
+} // namespace VPF
@@ -0,0 +1,158 @@
+/*
+ * Copyright 2020 NVIDIA Corporation
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include "DemuxerPool.hpp"
+#include "FFmpegDemuxer.h"
+#include "InterruptHandler.hpp"
+#include <future>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/* Demuxes ordered list of segments as single continuous stream;
+ * Next segment is opened and probed in background while current one is read.
+ * Video timestamps are given in first segment time base and are shifted so
+ * that every segment starts where previous one ends;
+ * Segments are expected to have same streams layout. Non-video streams are
+ * read from current segment, which is switched by video demuxing only;
+ * Single segment playlist behaves exactly like FFmpegDemuxer;
+ */
+class DllExport PlaylistDemuxer {
+public:
+  PlaylistDemuxer(const std::vector<std::string> &segments,
+                  const std::map<std::string, std::string> &ffmpeg_options);
+
+  /* Segment demuxers are taken from pool and given back to it, pool options
+   * are used;
+   */
+  PlaylistDemuxer(const std::vector<std::string> &segments,
+                  std::shared_ptr<DemuxerPool> pool);
+  ~PlaylistDemuxer();
+
+  /* Binds to new playlist, current segment demuxer is reused;
+   * Clears interrupt;
+   */
+  void Reopen(const std::vector<std::string> &segments);
+
+  AVCodecID GetVideoCodec() const;
+
+  uint32_t GetWidth() const;
+
+  uint32_t GetHeight() const;
+
+  double GetFramerate() const;
+
+  // Time base of first segment, all video timestamps are given in it;
+  double GetTimebase() const;
+
+  uint32_t GetVideoStreamIndex() const;
+
+  AVPixelFormat GetPixelFormat() const;
+
+  // Index of segment which is being read;
+  uint32_t GetSegmentIndex() const;
+
+  bool Demux(uint8_t *&pVideo, size_t &rVideoBytes);
+
+  /* Batch never spans across segments boundary, so it may be shorter than
+   * requested at the end of segment;
+   */
+  bool DemuxBatch(uint32_t maxPackets, size_t maxBytes, uint8_t *&pVideo,
+                  size_t &rVideoBytes, std::vector<PacketBatchEntry> &entries);
+
+  void GetLastPacketData(PacketData &pktData);
+
+  const std::vector<int> &GetExtraStreams() const;
+
+  bool DemuxStream(int streamIndex, uint8_t *&pData, size_t &rBytes);
+
+  bool GetAudioContext(int streamIndex, AudioContext &audioContext) const;
+
+  void SetPacketFilter(const PacketFilter &filter);
+
+  /* Timestamp is given in seconds in output timeline, same as demuxed
+   * packets have. Segment which was read before is opened again if timestamp
+   * falls into it, segments which weren't read yet can't be told apart;
+   * Clears interrupt, next segment is opened again if it was interrupted;
+   */
+  bool Seek(double timestamp);
+
+  /* Aborts I/O of current segment and of the one opened in background until
+   * Reopen() or Seek() is called. Thread-safe;
+   */
+  void Interrupt();
+
+  bool IsTimedOut() const;
+
+private:
+  void Start();
+
+  FFmpegDemuxer *OpenSegment(size_t idx) const;
+
+  void ReleaseSegment(FFmpegDemuxer *segment) const;
+
+  void PrefetchNextSegment();
+
+  void DropNextSegment();
+
+  bool NextSegment();
+
+  // Makes segment which was read before current one again;
+  bool SwitchSegment(size_t idx);
+
+  void SaveBounds();
+
+  // Rebases timestamp given in segment stream time base;
+  int64_t Rebase(int64_t ts, double streamTimebase, double outTimebase) const;
+
+  // Rebases video timestamps and moves output timeline end;
+  void RebaseVideo(int64_t &pts, int64_t &dts, uint64_t &duration);
+
+  std::vector<std::string> segments;
+  std::map<std::string, std::string> options;
+  std::shared_ptr<DemuxerPool> pool;
+
+  std::unique_ptr<FFmpegDemuxer> current;
+  std::future<FFmpegDemuxer *> next;
+  size_t segmentIdx = 0U;
+
+  double timebase = 0.0;
+
+  /* Segment start in its own timeline and in output timeline, in seconds;
+   * Output end is end of last video packet in output timeline;
+   */
+  bool hasSegmentStart = false;
+  double segmentStart = 0.0;
+  double segmentOffset = 0.0;
+  double outputEnd = 0.0;
+
+  struct SegmentBounds {
+    bool isRead = false;
+    bool hasStart = false;
+    double start = 0.0;
+    double offset = 0.0;
+  };
+
+  // Bounds of segments which were read, by segment index;
+  std::vector<SegmentBounds> bounds;
+
+  PacketData lastPacketData;
+  PacketFilter packetFilter;
+
+  // Segment demuxers are linked to it;
+  VPF::InterruptHandler interruptHandler;
+};
@@ -0,0 +1,62 @@
+/*
+ * Copyright 2020 NVIDIA Corporation
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include "Tasks.hpp"
+#include <map>
+#include <string>
+
+namespace VPF {
+
+/* Cuts [start, end) range of input video to output file without decoding;
+ * Packets are copied starting from keyframe at or before start, timestamps
+ * are rebased so output starts at zero. Start and end are given in seconds
+ * in same timeline as packet timestamps;
+ * Packets are selected by presentation time. Those shown at or after end are
+ * only written if frames shown before end may refer to them;
+ * Output is video-only: audio and other streams of input are dropped, as
+ * muxer handles single video stream. Every trimmer writes single output
+ * file;
+ */
+class DllExport StreamCopyTrimmer {
+public:
+  StreamCopyTrimmer() = delete;
+  StreamCopyTrimmer(const StreamCopyTrimmer &other) = delete;
+  StreamCopyTrimmer &operator=(const StreamCopyTrimmer &other) = delete;
+
+  StreamCopyTrimmer(const char *input, const char *output,
+                    const std::map<std::string, std::string> &ffmpeg_options);
+  ~StreamCopyTrimmer();
+
+  /* Output starts at keyframe at or before start;
+   * Returns number of packets written;
+   */
+  uint32_t Trim(double start, double end);
+
+  /* Frame-accurate trim;
+   * Part of leading GOP which lies before start is dropped, rest of it is
+   * decoded and encoded again. Packets after leading GOP are copied;
+   * Encoder options are same as for NvencEncodeFrame, codec and frame size
+   * default to those of input;
+   * Returns number of packets written;
+   */
+  uint32_t TrimReencode(double start, double end, CUcontext context,
+                        CUstream stream,
+                        const std::map<std::string, std::string> &enc_options);
+
+private:
+  struct StreamCopyTrimmer_Impl *pImpl = nullptr;
+};
+
+} // namespace VPF
@@ -17,6 +17,10 @@
 #include "NvCodecCLIOptions.h"
 #include "TC_CORE.hpp"
 #include "cuviddec.h"
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
 
 extern "C" {
   #include <libavutil/frame.h>
@@ -24,6 +28,8 @@ extern "C" {
 
 using namespace VPF;
 
+class DemuxerPool;
+
 // VPF stands for Video Processing Framework;
 namespace VPF {
 class DllExport NvencEncodeFrame final : public Task {
@@ -86,19 +92,88 @@ public:
   TaskExecStatus Execute() final;
   TaskExecStatus GetSideData(AVFrameSideDataType);
 
+  // Aborts blocking I/O, may be called from any thread;
+  void Interrupt();
+
+  // Format and size of last decoded frame;
+  Pixel_Format GetPixelFormat() const;
+  uint32_t GetWidth() const;
+  uint32_t GetHeight() const;
+
+  // Timestamp of last decoded frame in seconds, NaN if it's unknown;
+  double GetTimestamp() const;
+
+  /* Changes "skip_frame", "skip_loop_filter", "skip_idct" and "fast"
+   * options, takes effect from next frame on. Same options are accepted
+   * alongside other decoder options;
+   */
+  void SetSkipOptions(const std::map<std::string, std::string> &options);
+
+  /* Decodes frames shown at given timestamps (in seconds) with as few seeks
+   * as possible. Frames are packed back to back into output Buffer in order
+   * of timestamps, frame_sizes tells size of every one of them;
+   */
+  TaskExecStatus SampleFrames(const std::vector<double> &timestamps,
+                              std::vector<size_t> &frame_sizes);
+
   ~FfmpegDecodeFrame() final;
   static FfmpegDecodeFrame *Make(const char *URL,
                                  NvDecoderClInterface &cli_iface);
 
 private:
-  static const uint32_t num_inputs = 0U;
-  // Reconstructed pixels + side data;
-  static const uint32_t num_outputs = 2U;
+  /* Optional destination buffer. If its size matches decoded frame, pixels
+   * are written straight into it and it's given back as output;
+   */
+  static const uint32_t num_inputs = 1U;
+  // Reconstructed pixels + side data + FrameMetadata;
+  static const uint32_t num_outputs = 3U;
   struct FfmpegDecodeFrame_Impl *pImpl = nullptr;
 
   FfmpegDecodeFrame(const char *URL, NvDecoderClInterface &cli_iface);
 };
 
+/* Decodes single input with a pool of FFmpeg decoders, each one takes its
+ * own range of GOPs. Frames are given away in display order;
+ * Besides decoder options, "workers" (number of decoders), "gops_per_range"
+ * and "max_frames_ahead" are accepted. The latter bounds frames which are
+ * decoded ahead, by default they take about 1 GB;
+ */
+class DllExport FfmpegParallelDecodeFrame final : public Task {
+public:
+  FfmpegParallelDecodeFrame() = delete;
+  FfmpegParallelDecodeFrame(const FfmpegParallelDecodeFrame &other) = delete;
+  FfmpegParallelDecodeFrame &
+  operator=(const FfmpegParallelDecodeFrame &other) = delete;
+
+  /* Returns TASK_EXEC_TIMEOUT if any read of range which is given away
+   * takes longer than "read_timeout" option, range is decoded again by next
+   * call;
+   */
+  TaskExecStatus Execute() final;
+
+  /* Aborts blocking I/O of all workers, may be called from any thread;
+   * Decoding can't be resumed after that;
+   */
+  void Interrupt();
+
+  // Format and size of last decoded frame;
+  Pixel_Format GetPixelFormat() const;
+  uint32_t GetWidth() const;
+  uint32_t GetHeight() const;
+
+  ~FfmpegParallelDecodeFrame() final;
+  static FfmpegParallelDecodeFrame *Make(const char *URL,
+                                         NvDecoderClInterface &cli_iface);
+
+private:
+  // Optional destination buffer, same as FfmpegDecodeFrame has;
+  static const uint32_t num_inputs = 1U;
+  static const uint32_t num_outputs = 1U;
+  struct FfmpegParallelDecodeFrame_Impl *pImpl = nullptr;
+
+  FfmpegParallelDecodeFrame(const char *URL, NvDecoderClInterface &cli_iface);
+};
+
 class DllExport CudaUploadFrame final : public Task {
 public:
   CudaUploadFrame() = delete;
@@ -148,14 +223,61 @@ public:
 
   void GetParams(struct MuxingParams &params) const;
   TaskExecStatus Execute() final;
+
+  /* Demuxes multiple video packets at once;
+   * Packets are stored back to back in output #0, their offsets, sizes and
+   * timestamps are given as array of PacketBatchEntry in output #2;
+   */
+  TaskExecStatus DemuxBatch(uint32_t numPackets, size_t byteBudget);
+
+  /* Demuxes next packet of non-video stream selected with "streams" option;
+   * Packet goes to output #3, muxing params with audio context to output #1;
+   */
+  TaskExecStatus DemuxStream(uint32_t streamIndex);
+  const std::vector<int> &GetExtraStreams() const;
+
+  /* Aborts blocking I/O of demuxer, may be called from any thread;
+   * Demux calls which don't finish within "read_timeout" option return
+   * TASK_EXEC_TIMEOUT;
+   */
+  void Interrupt();
   ~DemuxFrame() final;
   static DemuxFrame *Make(const char *url, const char **ffmpeg_options,
                           uint32_t opts_size);
 
+  /* Demuxes ordered list of segments as single stream with continuous
+   * timestamps; Next segment is opened in background;
+   */
+  static DemuxFrame *Make(const std::vector<std::string> &segments,
+                          const char **ffmpeg_options, uint32_t opts_size);
+
+  /* Segment demuxers are taken from pool, so short inputs are opened by
+   * reused demuxers. Pool options are used;
+   */
+  static DemuxFrame *Make(const std::vector<std::string> &segments,
+                          std::shared_ptr<DemuxerPool> pool);
+
+  // Index of segment which is being demuxed;
+  uint32_t GetSegmentIndex() const;
+
+  /* Seeks to keyframe at or before given timestamp in seconds;
+   * For playlists seek is done within current segment;
+   */
+  bool Seek(double timestamp);
+
+  /* Binds to new input with same options;
+   * Much cheaper than construction of new task for short inputs;
+   */
+  void Reopen(const std::vector<std::string> &segments);
+
 private:
-  DemuxFrame(const char *url, const char **ffmpeg_options, uint32_t opts_size);
+  DemuxFrame(const std::vector<std::string> &segments,
+             const char **ffmpeg_options, uint32_t opts_size);
+  DemuxFrame(const std::vector<std::string> &segments,
+             std::shared_ptr<DemuxerPool> pool);
   static const uint32_t numInputs = 0U;
-  static const uint32_t numOutputs = 2U;
+  // Elementary video + muxing params + batch entries + stream packet;
+  static const uint32_t numOutputs = 4U;
   struct DemuxFrame_Impl *pImpl = nullptr;
 };
 
@@ -0,0 +1,124 @@
+/*
+ * Copyright 2020 NVIDIA Corporation
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include "FFmpegDemuxer.h"
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Available with USE_IO_URING build option only, Linux 5.6+;
+struct io_uring;
+
+/* Shared io_uring instance which serves file reads of many data providers;
+ * Reads are queued without submission. Queued reads of all providers are
+ * submitted at once by whichever thread has to wait first, so readahead of
+ * different streams shares io_uring_enter() calls. Completions are reaped
+ * by single thread;
+ * Read buffers are registered with kernel. Providers which don't get one
+ * fall back to their own memory;
+ */
+class DllExport UringService {
+public:
+  UringService(uint32_t queueDepth = 256U, uint32_t numBuffers = 64U,
+               uint32_t bufferSize = 512U * 1024U);
+  ~UringService();
+
+  UringService(const UringService &other) = delete;
+  UringService &operator=(const UringService &other) = delete;
+
+  // Instance shared by demuxers which are given "io_uring" option;
+  static std::shared_ptr<UringService> GetShared();
+
+  struct Request {
+    int fd = -1;
+    uint8_t *buffer = nullptr;
+    uint32_t size = 0U;
+    int64_t offset = 0;
+    // Index of registered buffer or -1;
+    int bufferIndex = -1;
+
+    // Bytes read or negative errno;
+    int32_t result = 0;
+    bool isDone = true;
+  };
+
+  // Returns -1 if there are no registered buffers left;
+  int AcquireBuffer(uint8_t *&buffer);
+  void ReleaseBuffer(int bufferIndex);
+  uint32_t GetBufferSize() const { return bufferSize; }
+
+  // Queues read, it's submitted later along with others;
+  void Queue(Request &request);
+
+  // Submits queued reads of all providers;
+  void Flush();
+
+  // Submits queued reads and waits for given one to complete;
+  int32_t Wait(Request &request);
+
+private:
+  void Reap();
+
+  std::unique_ptr<io_uring> ring;
+  uint32_t bufferSize;
+  bool isRegistered = false;
+
+  std::mutex submitMutex;
+  uint32_t numQueued = 0U;
+
+  std::mutex doneMutex;
+  std::condition_variable doneCv;
+
+  std::mutex bufferMutex;
+  uint8_t *bufferMem = nullptr;
+  std::vector<int> freeBuffers;
+
+  std::thread reaper;
+};
+
+/* Reads local file through shared io_uring instance;
+ * Read of next chunk is submitted before current one is consumed, so it's
+ * in flight meanwhile;
+ */
+class DllExport UringDataProvider final : public DataProvider {
+public:
+  UringDataProvider(const char *szFilePath,
+                    std::shared_ptr<UringService> service);
+  ~UringDataProvider() final;
+
+  int GetData(uint8_t *pBuf, int nBuf) final;
+  bool IsSeekable() const final { return true; }
+  int64_t Seek(int64_t offset, int whence) final;
+
+private:
+  struct Chunk {
+    UringService::Request request;
+    std::vector<uint8_t> ownMem;
+    bool isValid = false;
+  };
+
+  void Read(Chunk &chunk, int64_t offset);
+  void Drain(Chunk &chunk);
+
+  std::shared_ptr<UringService> service;
+  int fd = -1;
+  int64_t fileSize = 0;
+  int64_t position = 0;
+
+  Chunk chunks[2];
+  uint32_t current = 0U;
+};
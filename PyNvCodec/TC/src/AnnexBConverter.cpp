@@ -0,0 +1,140 @@
+/*
+ * Copyright 2020 NVIDIA Corporation
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "AnnexBConverter.hpp"
+#include "NalParser.hpp"
+#include <cstring>
+
+using namespace VPF;
+using namespace std;
+
+static const uint8_t startCode[] = {0x00, 0x00, 0x00, 0x01};
+
+static uint32_t ReadNalLength(const uint8_t *p, uint32_t nalLengthSize) {
+  uint32_t length = 0U;
+  for (auto i = 0U; i < nalLengthSize; i++) {
+    length = (length << 8) | p[i];
+  }
+  return length;
+}
+
+void AnnexBConverter::Init(const uint8_t *extradata, size_t size,
+                           bool is_hevc) {
+  isHEVC = is_hevc;
+  nalLengthSize = 0U;
+  paramSets.clear();
+
+  Update(extradata, size);
+}
+
+bool AnnexBConverter::Update(const uint8_t *extradata, size_t size) {
+  ParameterSets sets;
+  if (!ParseExtradata(extradata, size, isHEVC, sets) || !sets.nalLengthSize) {
+    return false;
+  }
+
+  nalLengthSize = sets.nalLengthSize;
+  paramSets.clear();
+  for (auto *list : {&sets.vps, &sets.sps, &sets.pps}) {
+    for (auto &nal : *list) {
+      paramSets.insert(paramSets.end(), startCode, startCode + 4);
+      paramSets.insert(paramSets.end(), nal.begin(), nal.end());
+    }
+  }
+
+  return true;
+}
+
+bool AnnexBConverter::Convert(const uint8_t *data, size_t size,
+                              vector<uint8_t> &output) const {
+  if (IsPassthrough()) {
+    output.insert(output.end(), data, data + size);
+    return true;
+  }
+
+  /* Validate NAL units sizes and look for in-band parameter sets and first
+   * slice before writing anything;
+   */
+  auto hasParamSets = false, hasEmptyNals = false, isRandomAccess = false;
+  auto firstSlicePos = size;
+  auto numNals = 0U;
+
+  for (size_t pos = 0U; pos < size;) {
+    if (size - pos < nalLengthSize) {
+      return false;
+    }
+    auto nalSize = ReadNalLength(data + pos, nalLengthSize);
+    auto nalPos = pos + nalLengthSize;
+    if (nalSize > size - nalPos) {
+      return false;
+    }
+
+    numNals++;
+    if (!nalSize) {
+      hasEmptyNals = true;
+    } else if (isHEVC) {
+      auto nalType = (data[nalPos] >> 1) & 0x3f;
+      hasParamSets |= (nalType >= 32 && nalType <= 34);
+      if (nalType < 32 && firstSlicePos == size) {
+        firstSlicePos = pos;
+        isRandomAccess = (nalType >= 16 && nalType <= 23);
+      }
+    } else {
+      auto nalType = data[nalPos] & 0x1f;
+      hasParamSets |= (7 == nalType || 8 == nalType);
+      if (nalType >= 1 && nalType <= 5 && firstSlicePos == size) {
+        firstSlicePos = pos;
+        isRandomAccess = (5 == nalType);
+      }
+    }
+
+    pos = nalPos + nalSize;
+  }
+
+  auto const insertParamSets = isRandomAccess && !hasParamSets;
+  auto const start = output.size();
+
+  // Start code has the same size as prefix, so it's rewritten in place;
+  if (4U == nalLengthSize && !insertParamSets && !hasEmptyNals) {
+    output.insert(output.end(), data, data + size);
+    auto *p = output.data() + start;
+
+    for (size_t pos = 0U; pos < size;) {
+      auto nalSize = ReadNalLength(p + pos, nalLengthSize);
+      memcpy(p + pos, startCode, sizeof(startCode));
+      pos += nalLengthSize + nalSize;
+    }
+    return true;
+  }
+
+  output.reserve(start + size + numNals * sizeof(startCode) +
+                 (insertParamSets ? paramSets.size() : 0U));
+
+  for (size_t pos = 0U; pos < size;) {
+    auto nalSize = ReadNalLength(data + pos, nalLengthSize);
+    auto nalPos = pos + nalLengthSize;
+
+    if (insertParamSets && pos == firstSlicePos) {
+      output.insert(output.end(), paramSets.begin(), paramSets.end());
+    }
+
+    if (nalSize) {
+      output.insert(output.end(), startCode, startCode + sizeof(startCode));
+      output.insert(output.end(), data + nalPos, data + nalPos + nalSize);
+    }
+
+    pos = nalPos + nalSize;
+  }
+
+  return true;
+}
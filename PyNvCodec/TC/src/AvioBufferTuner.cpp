@@ -0,0 +1,140 @@
+/*
+ * Copyright 2020 NVIDIA Corporation
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "AvioBufferTuner.hpp"
+#include <algorithm>
+#include <cstring>
+
+extern "C" {
+#include <libavutil/mem.h>
+}
+
+using namespace std;
+using namespace std::chrono;
+
+namespace VPF {
+
+// Buffer size is revised once per this many refills;
+static const uint32_t refillsPerUpdate = 16U;
+
+// Refill which takes longer than that is considered slow, in seconds;
+static const double slowRefillTime = 0.01;
+
+void AvioBufferTuner::Configure(bool adaptive, uint32_t maxBufferSize,
+                                double bufferDuration) {
+  this->adaptive = adaptive;
+  this->maxBufferSize = max(maxBufferSize, minBufferSize);
+  this->bufferDuration = bufferDuration;
+  Reset();
+}
+
+void AvioBufferTuner::Reset() {
+  hasFirst = false;
+  numRefills = 0U;
+  refillTime = 0.0;
+}
+
+void AvioBufferTuner::BeginRead(AVIOContext *pb) {
+  if (!adaptive || !pb) {
+    return;
+  }
+
+  posBefore = pb->pos;
+  readStart = steady_clock::now();
+}
+
+void AvioBufferTuner::EndRead(AVIOContext *pb, int64_t ts, double timeBase) {
+  if (!adaptive || !pb) {
+    return;
+  }
+
+  // Position is advanced by refills only;
+  if (pb->pos != posBefore) {
+    numRefills++;
+    refillTime += duration<double>(steady_clock::now() - readStart).count();
+  }
+
+  if (AV_NOPTS_VALUE != ts) {
+    lastTs = ts * timeBase;
+    if (!hasFirst) {
+      hasFirst = true;
+      firstTs = lastTs;
+      firstPos = pb->pos;
+    }
+  }
+
+  if (numRefills >= refillsPerUpdate) {
+    Update(pb);
+    numRefills = 0U;
+    refillTime = 0.0;
+  }
+}
+
+void AvioBufferTuner::Update(AVIOContext *pb) {
+  auto const currentSize = (uint32_t)pb->buffer_size;
+  double target = currentSize;
+
+  auto const mediaTime = lastTs - firstTs;
+  auto const numBytes = pb->pos - firstPos;
+  if (hasFirst && mediaTime > 0.0 && numBytes > 0) {
+    target = numBytes / mediaTime * bufferDuration;
+  }
+
+  if (refillTime / numRefills > slowRefillTime) {
+    target = max(target, 2.0 * currentSize);
+  }
+
+  target = min(max(target, (double)minBufferSize), (double)maxBufferSize);
+
+  uint32_t newSize = minBufferSize;
+  while (newSize < target && newSize <= maxBufferSize / 2U) {
+    newSize *= 2U;
+  }
+
+  // Buffer is shrunk reluctantly, so it isn't resized back and forth;
+  if (newSize > currentSize || 4U * newSize <= currentSize) {
+    Resize(pb, newSize);
+  }
+}
+
+bool AvioBufferTuner::Resize(AVIOContext *pb, uint32_t newSize) {
+  if (!pb || pb->write_flag || pb->direct || !newSize) {
+    return false;
+  }
+
+  auto const numUnread = (size_t)(pb->buf_end - pb->buf_ptr);
+  if (numUnread > newSize) {
+    return false;
+  }
+
+  auto buffer = (uint8_t *)av_malloc(newSize);
+  if (!buffer) {
+    return false;
+  }
+  memcpy(buffer, pb->buf_ptr, numUnread);
+  av_free(pb->buffer);
+
+  /* Position of buffer start is derived from pos and buf_end, so seeking
+   * stays correct;
+   */
+  pb->buffer = buffer;
+  pb->buffer_size = newSize;
+  pb->orig_buffer_size = newSize;
+  pb->buf_ptr = buffer;
+  pb->buf_end = buffer + numUnread;
+  pb->checksum_ptr = buffer;
+
+  return true;
+}
+
+} // namespace VPF
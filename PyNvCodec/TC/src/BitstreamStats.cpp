@@ -0,0 +1,183 @@
+/*
+ * Copyright 2020 NVIDIA Corporation
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "BitstreamStats.hpp"
+#include <algorithm>
+#include <sstream>
+#include <stdexcept>
+
+using namespace std;
+
+static const uint32_t numSizeBins = 32U;
+
+BitstreamStatsCollector::BitstreamStatsCollector(double timeBase,
+                                                 double window)
+    : timeBase(timeBase), firstTs(AV_NOPTS_VALUE), lastTs(AV_NOPTS_VALUE),
+      firstKeyTs(AV_NOPTS_VALUE), lastKeyTs(AV_NOPTS_VALUE) {
+  if (timeBase <= 0.0 || window <= 0.0) {
+    stringstream ss;
+    ss << __FUNCTION__ << ": time base and window must be positive";
+    throw invalid_argument(ss.str());
+  }
+
+  stats.window = window;
+  stats.sizeHistogram.resize(numSizeBins, 0U);
+}
+
+void BitstreamStatsCollector::Add(const PacketData &packetData,
+                                  size_t packetSize) {
+  /* Decode timestamps grow monotonically, so they are preferred;
+   * Packets without any timestamp are placed right after previous one;
+   */
+  int64_t ts = packetData.dts;
+  if (AV_NOPTS_VALUE == ts) {
+    ts = packetData.pts;
+  }
+  if (AV_NOPTS_VALUE == ts) {
+    ts = (AV_NOPTS_VALUE == lastTs) ? 0 : lastTs + lastDuration;
+  }
+  if (AV_NOPTS_VALUE == firstTs) {
+    firstTs = ts;
+  }
+
+  stats.numPackets++;
+  stats.totalBytes += packetSize;
+
+  // Bits are accumulated here, turned to bitrate by Finish();
+  auto const elapsed = max(0.0, (ts - firstTs) * timeBase);
+  auto const windowIdx = (size_t)(elapsed / stats.window);
+  if (windowIdx >= stats.bitrate.size()) {
+    stats.bitrate.resize(windowIdx + 1U, 0.0);
+  }
+  stats.bitrate[windowIdx] += packetSize * 8.0;
+
+  uint32_t bin = 0U;
+  for (auto size = packetSize; size > 1U && bin < numSizeBins - 1U;
+       size >>= 1) {
+    bin++;
+  }
+  stats.sizeHistogram[bin]++;
+
+  if (packetData.flags & AV_PKT_FLAG_KEY) {
+    if (AV_NOPTS_VALUE == firstKeyTs) {
+      firstKeyTs = ts;
+    } else {
+      auto const interval = (ts - lastKeyTs) * timeBase;
+      stats.minKeyframeInterval =
+          stats.numKeyframes > 1U ? min(stats.minKeyframeInterval, interval)
+                                  : interval;
+      stats.maxKeyframeInterval = max(stats.maxKeyframeInterval, interval);
+    }
+    lastKeyTs = ts;
+    stats.numKeyframes++;
+
+    if (gopSize) {
+      stats.gopSizes.push_back(gopSize);
+    }
+    gopSize = 0U;
+  }
+  gopSize++;
+
+  if (packetData.isIDR) {
+    stats.numIDR++;
+  }
+
+  switch (packetData.sliceType) {
+  case VPF::SLICE_TYPE_I:
+    stats.numI++;
+    break;
+  case VPF::SLICE_TYPE_P:
+    stats.numP++;
+    break;
+  case VPF::SLICE_TYPE_B:
+    stats.numB++;
+    break;
+  default:
+    break;
+  }
+
+  // Counted in decode order;
+  numConsecutiveB = (VPF::SLICE_TYPE_B == packetData.sliceType)
+                        ? numConsecutiveB + 1U
+                        : 0U;
+  stats.maxConsecutiveB = max(stats.maxConsecutiveB, numConsecutiveB);
+
+  lastTs = ts;
+  lastDuration = (int64_t)packetData.duration;
+}
+
+const BitstreamStats &BitstreamStatsCollector::Finish() {
+  if (isFinished) {
+    return stats;
+  }
+  isFinished = true;
+
+  if (gopSize) {
+    stats.gopSizes.push_back(gopSize);
+    gopSize = 0U;
+  }
+
+  if (!stats.numPackets) {
+    return stats;
+  }
+
+  stats.duration = (lastTs + lastDuration - firstTs) * timeBase;
+  if (stats.duration > 0.0) {
+    stats.avgBitrate = stats.totalBytes * 8.0 / stats.duration;
+  }
+
+  // Last window is usually incomplete;
+  for (size_t i = 0U; i < stats.bitrate.size(); i++) {
+    auto length = stats.window;
+    if (i + 1U == stats.bitrate.size()) {
+      auto const rest = stats.duration - i * stats.window;
+      length = (rest > 0.0 && rest < stats.window) ? rest : stats.window;
+    }
+    stats.bitrate[i] /= length;
+    stats.maxBitrate = max(stats.maxBitrate, stats.bitrate[i]);
+  }
+
+  if (!stats.gopSizes.empty()) {
+    auto minmax = minmax_element(stats.gopSizes.begin(), stats.gopSizes.end());
+    stats.minGopSize = *minmax.first;
+    stats.maxGopSize = *minmax.second;
+    stats.avgGopSize = (double)stats.numPackets / stats.gopSizes.size();
+  }
+
+  if (stats.numKeyframes > 1U) {
+    stats.avgKeyframeInterval =
+        (lastKeyTs - firstKeyTs) * timeBase / (stats.numKeyframes - 1U);
+  }
+
+  return stats;
+}
+
+BitstreamStats BitstreamStatsCollector::Collect(FFmpegDemuxer &demuxer,
+                                                double window) {
+  BitstreamStatsCollector collector(demuxer.GetTimebase(), window);
+
+  uint8_t *pVideo = nullptr;
+  size_t videoBytes = 0U;
+  PacketData packetData;
+
+  while (demuxer.Demux(pVideo, videoBytes)) {
+    demuxer.GetLastPacketData(packetData);
+    collector.Add(packetData, videoBytes);
+  }
+
+  if (demuxer.IsTimedOut()) {
+    throw VPF::TimeoutException("Bitstream statistics pass has timed out");
+  }
+
+  return collector.Finish();
+}
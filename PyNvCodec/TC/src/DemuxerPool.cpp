@@ -0,0 +1,81 @@
+/*
+ * Copyright 2020 NVIDIA Corporation
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "DemuxerPool.hpp"
+#include <iostream>
+
+using namespace std;
+
+DemuxerPool::DemuxerPool(const map<string, string> &ffmpeg_options,
+                         size_t maxIdle)
+    : options(ffmpeg_options), maxIdle(maxIdle) {}
+
+DemuxerPool::~DemuxerPool() = default;
+
+FFmpegDemuxer *
+DemuxerPool::Acquire(const char *szFilePath,
+                     const VPF::InterruptHandler *parentInterrupt) {
+  unique_ptr<FFmpegDemuxer> demuxer;
+  {
+    lock_guard<mutex> lock(poolMutex);
+    if (!idle.empty()) {
+      demuxer = move(idle.back());
+      idle.pop_back();
+    }
+  }
+
+  if (demuxer) {
+    try {
+      demuxer->LinkInterrupt(parentInterrupt);
+      demuxer->Reopen(szFilePath);
+      return demuxer.release();
+    } catch (VPF::TimeoutException &) {
+      throw;
+    } catch (exception &e) {
+      /* Parameters of previous input may not fit the new one. That's the
+       * only case when new demuxer does better, other errors are given to
+       * caller as is;
+       */
+      auto const isInterrupted =
+          parentInterrupt && parentInterrupt->IsInterrupted();
+      if (isInterrupted || !demuxer->HasInheritedParams()) {
+        throw;
+      }
+      cerr << "Can't reopen pooled demuxer: " << e.what() << endl;
+    }
+  }
+
+  return new FFmpegDemuxer(szFilePath, options, parentInterrupt);
+}
+
+void DemuxerPool::Release(FFmpegDemuxer *pDemuxer) {
+  if (!pDemuxer) {
+    return;
+  }
+
+  unique_ptr<FFmpegDemuxer> demuxer(pDemuxer);
+  demuxer->Close();
+  demuxer->LinkInterrupt(nullptr);
+
+  lock_guard<mutex> lock(poolMutex);
+  if (idle.size() < maxIdle) {
+    idle.push_back(move(demuxer));
+  }
+}
+
+const map<string, string> &DemuxerPool::GetOptions() const { return options; }
+
+size_t DemuxerPool::GetNumIdle() const {
+  lock_guard<mutex> lock(poolMutex);
+  return idle.size();
+}
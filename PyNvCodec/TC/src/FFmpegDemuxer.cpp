@@ -12,15 +12,32 @@
  */
 
 #include "FFmpegDemuxer.h"
+#include "AnnexBConverter.hpp"
+#include "FileDataProvider.hpp"
+#include "NalParser.hpp"
 #include "NvCodecUtils.h"
+#ifdef USE_IO_URING
+#include "UringDataProvider.hpp"
+#endif
 #include "libavutil/avstring.h"
 #include "libavutil/avutil.h"
+#include <algorithm>
 #include <iostream>
 #include <limits>
+#include <mutex>
 #include <sstream>
 
 using namespace std;
 
+// Global libavformat initialization, done once per process;
+static void InitLibavformat() {
+  static once_flag initFlag;
+  call_once(initFlag, []() {
+    av_register_all();
+    avformat_network_init();
+  });
+}
+
 static string AvErrorToString(int av_error_code) {
   const auto buf_size = 1024U;
   char *err_string = (char *)calloc(buf_size, sizeof(*err_string));
@@ -40,20 +57,229 @@ static string AvErrorToString(int av_error_code) {
   return str;
 }
 
-class DataProvider {
-public:
-  virtual ~DataProvider() = default;
-  virtual int GetData(uint8_t *pBuf, int nBuf) = 0;
-};
+/* Moves VPF-specific entries from options map to demuxer settings;
+ * Returns options which shall be passed to libavformat;
+ */
+static map<string, string>
+ExtractSettings(const map<string, string> &ffmpeg_options,
+                DemuxerSettings &settings) {
+  map<string, string> av_options(ffmpeg_options);
+
+  auto take = [&](const string &key, string &value) {
+    auto it = av_options.find(key);
+    if (it == av_options.end()) {
+      return false;
+    }
+    value = it->second;
+    av_options.erase(it);
+    return true;
+  };
+
+  string value;
+  try {
+    if (take("fast_open", value)) {
+      settings.fastOpen = (0 != stoi(value));
+    }
+
+    if (take("cached_codec", value)) {
+      auto desc = avcodec_descriptor_get_by_name(value.c_str());
+      if (!desc) {
+        throw invalid_argument("unknown codec name " + value);
+      }
+      settings.cachedCodec = desc->id;
+    }
+
+    if (take("cached_width", value)) {
+      settings.cachedWidth = stoul(value);
+    }
+
+    if (take("cached_height", value)) {
+      settings.cachedHeight = stoul(value);
+    }
+
+    if (take("cached_framerate", value)) {
+      settings.cachedFramerate = stod(value);
+    }
+
+    auto &filter = settings.packetFilter;
+    if (take("packet_filter", value)) {
+      if ("all" == value) {
+        filter.mode = FILTER_NONE;
+      } else if ("key" == value) {
+        filter.mode = FILTER_KEYFRAMES;
+      } else if ("nth_key" == value) {
+        filter.mode = FILTER_NTH_KEYFRAME;
+      } else if ("time_stride" == value) {
+        filter.mode = FILTER_TIME_STRIDE;
+      } else {
+        throw invalid_argument("unknown packet filter");
+      }
+    }
+
+    if (take("keyframe_step", value)) {
+      filter.keyframeStep = stoul(value);
+    }
+
+    if (take("time_stride", value)) {
+      filter.timeStride = stod(value);
+    }
+
+    if (take("annexb", value)) {
+      settings.annexb = (0 != stoi(value));
+    }
+
+    if (take("nal_info", value)) {
+      settings.nalInfo = (0 != stoi(value));
+    }
+
+    take("streams", settings.streams);
+
+    if (take("max_queued_packets", value)) {
+      settings.maxQueuedPackets = stoul(value);
+    }
+
+    if (take("open_timeout", value)) {
+      settings.openTimeout = stod(value);
+    }
+
+    if (take("read_timeout", value)) {
+      settings.readTimeout = stod(value);
+    }
+
+    if (take("avio_buffer_size", value)) {
+      settings.avioBufferSize = stoul(value);
+    }
+
+    if (take("avio_adaptive", value)) {
+      settings.avioAdaptive = (0 != stoi(value));
+    }
+
+    if (take("avio_max_buffer_size", value)) {
+      settings.avioMaxBufferSize = stoul(value);
+    }
+
+    if (take("avio_buffer_duration", value)) {
+      settings.avioBufferDuration = stod(value);
+    }
+
+    if (take("io_uring", value)) {
+      settings.ioUring = (0 != stoi(value));
+    }
+
+    if (take("gop_cache_size", value)) {
+      settings.gopCacheSize = stoull(value);
+    }
+  } catch (exception &e) {
+    stringstream ss;
+    ss << "Invalid demuxer option value " << value << ": " << e.what() << endl;
+    throw invalid_argument(ss.str());
+  }
+
+  /* Fast open may still fall back to streams probing. Keep it short unless
+   * probesize and analyzeduration are given explicitly;
+   */
+  if (settings.fastOpen) {
+    av_options.emplace("probesize", "131072");
+    av_options.emplace("analyzeduration", "500000");
+  }
+
+  return av_options;
+}
 
 FFmpegDemuxer::FFmpegDemuxer(const char *szFilePath,
-                             const map<string, string> &ffmpeg_options)
-    : FFmpegDemuxer(CreateFormatContext(szFilePath, ffmpeg_options)) {}
+                             const map<string, string> &ffmpeg_options,
+                             const VPF::InterruptHandler *parentInterrupt) {
+  interruptHandler.Link(parentInterrupt);
+  avOptions = ExtractSettings(ffmpeg_options, settings);
+  inheritCachedParams = (AV_CODEC_ID_NONE == settings.cachedCodec);
+  cacheSource = szFilePath;
+  Init(CreateFormatContext(szFilePath, avOptions));
+}
 
 FFmpegDemuxer::FFmpegDemuxer(DataProvider *pDataProvider,
-                             const map<string, string> &ffmpeg_options)
-    : FFmpegDemuxer(CreateFormatContext(pDataProvider, ffmpeg_options)) {
-  avioc = fmtc->pb;
+                             const map<string, string> &ffmpeg_options) {
+  avOptions = ExtractSettings(ffmpeg_options, settings);
+  inheritCachedParams = (AV_CODEC_ID_NONE == settings.cachedCodec);
+  cacheSource.clear();
+  Init(CreateFormatContext(pDataProvider, avOptions));
+}
+
+void FFmpegDemuxer::Close() {
+  if (pkt.data) {
+    av_packet_unref(&pkt);
+  }
+
+  if (streamPkt.data) {
+    av_packet_unref(&streamPkt);
+  }
+
+  FlushStreamQueues();
+  streamQueues.clear();
+  extraStreams.clear();
+
+  for (auto &probed : probedPackets) {
+    av_packet_free(&probed);
+  }
+  probedPackets.clear();
+
+  avformat_close_input(&fmtc);
+  ownProvider.reset();
+}
+
+/* Parameters of previous input are fallback for fast open of the next one,
+ * unless caller has given them. Inputs which are reopened one after another
+ * are alike as a rule, so streams probing is skipped for them;
+ */
+void FFmpegDemuxer::InheritCachedParams() {
+  if (!settings.fastOpen || !inheritCachedParams || !fmtc ||
+      videoStream < 0) {
+    return;
+  }
+
+  settings.cachedCodec = eVideoCodec;
+  settings.cachedWidth = width;
+  settings.cachedHeight = height;
+  settings.cachedFramerate = framerate;
+}
+
+bool FFmpegDemuxer::HasInheritedParams() const {
+  return settings.fastOpen && inheritCachedParams &&
+         AV_CODEC_ID_NONE != settings.cachedCodec;
+}
+
+void FFmpegDemuxer::Reopen(const char *szFilePath) {
+  InheritCachedParams();
+  Close();
+  interruptHandler.Reset();
+  cacheSource = szFilePath;
+
+  /* Local files are read through own AVIO context, so that its buffer is
+   * reused instead of being allocated by libavformat for every input;
+   * io_uring provider does the same;
+   */
+  unique_ptr<DataProvider> provider;
+  if (!settings.ioUring && FileDataProvider::IsLocalFile(szFilePath)) {
+    try {
+      provider.reset(new FileDataProvider(szFilePath));
+    } catch (exception &e) {
+      cerr << e.what() << endl;
+    }
+  }
+
+  if (provider) {
+    ownProvider = move(provider);
+    Init(CreateFormatContext(ownProvider.get(), avOptions));
+  } else {
+    Init(CreateFormatContext(szFilePath, avOptions));
+  }
+}
+
+void FFmpegDemuxer::Reopen(DataProvider *pDataProvider) {
+  InheritCachedParams();
+  Close();
+  interruptHandler.Reset();
+  cacheSource.clear();
+  Init(CreateFormatContext(pDataProvider, avOptions));
 }
 
 uint32_t FFmpegDemuxer::GetWidth() const { return width; }
@@ -66,100 +292,660 @@ double FFmpegDemuxer::GetTimebase() const { return timebase; }
 
 uint32_t FFmpegDemuxer::GetVideoStreamIndex() const { return videoStream; }
 
-bool FFmpegDemuxer::Demux(uint8_t *&pVideo, size_t &rVideoBytes) {
-  if (!fmtc) {
+bool FFmpegDemuxer::GetStartTime(double &startTime) const {
+  if (!fmtc || videoStream < 0) {
+    return false;
+  }
+
+  auto const stream = fmtc->streams[videoStream];
+  if (AV_NOPTS_VALUE == stream->start_time) {
     return false;
   }
 
+  startTime = stream->start_time * av_q2d(stream->time_base);
+  return true;
+}
+
+bool FFmpegDemuxer::DemuxPacket() {
   if (pkt.data) {
     av_packet_unref(&pkt);
   }
 
-  if (!videoBytes.empty()) {
-    videoBytes.clear();
+  /* Cached GOP is replayed till its end. Then container is positioned at
+   * next GOP, unless it's cached as well;
+   */
+  if (replayedGop) {
+    if (ReplayPacket()) {
+      return true;
+    } else if (replayedGop) {
+      return false;
+    }
+  }
+
+  if (AV_NOPTS_VALUE != pendingSeekTs) {
+    /* Seek lands exactly at keyframe which was selected with index lookup;
+     * Reset filter state so that keyframe is accepted. Queued packets are
+     * from before seek position, so they are dropped;
+     */
+    if (av_seek_frame(fmtc, videoStream, pendingSeekTs, AVSEEK_FLAG_BACKWARD) >=
+        0) {
+      keyframeCounter = 0U;
+      lastSelectedTs = AV_NOPTS_VALUE;
+      FlushStreamQueues();
+    }
+    pendingSeekTs = AV_NOPTS_VALUE;
   }
 
-  auto appendBytes = [](vector<uint8_t> &elementaryBytes, AVPacket &avPacket,
-                        AVPacket &avPacketBsf, AVBSFContext *pAvbsfContext,
-                        int streamId, bool isFilteringNeeded) {
-    if (avPacket.stream_index != streamId) {
-      return;
+  bool isDone = false;
+  size_t packetOffset = 0U;
+
+  while (!isDone) {
+    if (!ReadStreamPacket(videoStream, pkt)) {
+      // Recording is kept on timeout as caller may retry;
+      if (!interruptHandler.IsTimedOut()) {
+        auto const isEOF = fmtc->pb && avio_feof(fmtc->pb);
+        if (isEOF) {
+          FinishRecording(AV_NOPTS_VALUE, true);
+        } else {
+          recordedGop.reset();
+        }
+      }
+      return false;
     }
 
-    if (isFilteringNeeded) {
-      if (avPacketBsf.data) {
-        av_packet_unref(&avPacketBsf);
+    if (AV_NOPTS_VALUE != resumePts) {
+      // Seek may land before GOP which follows replayed one;
+      if ((pkt.flags & AV_PKT_FLAG_KEY) && pkt.pts >= resumePts) {
+        resumePts = AV_NOPTS_VALUE;
+      } else {
+        av_packet_unref(&pkt);
+        continue;
       }
+    }
 
-      av_bsf_send_packet(pAvbsfContext, &avPacket);
-      av_bsf_receive_packet(pAvbsfContext, &avPacketBsf);
+    if (!IsSelected(pkt)) {
+      av_packet_unref(&pkt);
+      continue;
+    }
+    isDone = true;
 
-      elementaryBytes.insert(elementaryBytes.end(), avPacketBsf.data,
-                             avPacketBsf.data + avPacketBsf.size);
+    if (isNalStream) {
+      // Extradata may change on the fly, e. g. in adaptive streams;
+      int newExtradataSize = 0;
+      auto newExtradata = av_packet_get_side_data(
+          &pkt, AV_PKT_DATA_NEW_EXTRADATA, &newExtradataSize);
+      if (newExtradata && newExtradataSize > 0) {
+        if (!annexbConverter.Update(newExtradata, newExtradataSize)) {
+          cerr << "Can't parse new extradata, previous one is kept" << endl;
+        }
+        nalParser.SetExtradata(newExtradata, newExtradataSize);
+      }
+    }
+
+    packetOffset = videoBytes.size();
+    if (isAnnexBNeeded) {
+      if (!annexbConverter.Convert(pkt.data, pkt.size, videoBytes)) {
+        cerr << "Skipping malformed video packet at " << pkt.pos << endl;
+        av_packet_unref(&pkt);
+        isDone = false;
+      }
     } else {
-      elementaryBytes.insert(elementaryBytes.end(), avPacket.data,
-                             avPacket.data + avPacket.size);
+      videoBytes.insert(videoBytes.end(), pkt.data, pkt.data + pkt.size);
     }
-  };
+  }
 
-  int ret = 0;
-  bool isDone = false, gotVideo = false;
+  if (FILTER_NONE != settings.packetFilter.mode) {
+    ScheduleSeekToNextSelected(pkt);
+  }
 
-  while (!isDone) {
-    ret = av_read_frame(fmtc, &pkt);
-    gotVideo = (pkt.stream_index == videoStream);
-    isDone = (ret < 0) || gotVideo;
+  // Update last packet data;
+  lastPacketData.dts = pkt.dts;
+  lastPacketData.duration = pkt.duration;
+  lastPacketData.pos = pkt.pos;
+  lastPacketData.pts = pkt.pts;
+  lastPacketData.flags = pkt.flags;
 
-    /* Unref non-desired packets as we don't support them yet;
+  VPF::AccessUnitInfo info;
+  if (isNalStream && settings.nalInfo) {
+    /* Parse bytes as they are given to user, so parameter sets inserted by
+     * Annex.B converter are accounted for;
      */
-    if (pkt.stream_index != videoStream) {
-      av_packet_unref(&pkt);
+    auto data = videoBytes.data() + packetOffset;
+    auto size = videoBytes.size() - packetOffset;
+    if (settings.annexb || annexbConverter.IsPassthrough()) {
+      nalParser.ParseAnnexB(data, size, info);
+    } else {
+      nalParser.ParseLengthPrefixed(data, size,
+                                    annexbConverter.NalLengthSize(), info);
+    }
+  }
+
+  lastPacketData.nalTypes = info.nalTypes;
+  lastPacketData.sliceType = info.sliceType;
+  lastPacketData.nalRefIdc = info.nalRefIdc;
+  lastPacketData.temporalId = info.temporalId;
+  lastPacketData.isIDR = info.isIDR;
+  lastPacketData.isReference = info.isReference;
+  lastPacketData.hasVPS = info.hasVPS;
+  lastPacketData.hasSPS = info.hasSPS;
+  lastPacketData.hasPPS = info.hasPPS;
+
+  if (IsCacheable()) {
+    RecordPacket(packetOffset);
+  }
+
+  return true;
+}
+
+bool FFmpegDemuxer::IsCacheable() const {
+  return settings.gopCacheSize && !cacheSource.empty() &&
+         FILTER_NONE == settings.packetFilter.mode && extraStreams.empty();
+}
+
+/* Gives next packet of replayed GOP;
+ * Returns false and stops replay when container is positioned at next GOP.
+ * Replay goes on if there's no next GOP or seek has failed;
+ */
+bool FFmpegDemuxer::ReplayPacket() {
+  while (replayedPacket >= replayedGop->packets.size()) {
+    if (replayedGop->isLast) {
+      return false;
+    }
+
+    auto const endPts = replayedGop->endPts;
+    auto next = GopCache::GetShared().Find(cacheSource, endPts);
+    if (next) {
+      replayedGop = next;
+      replayedPacket = 0U;
       continue;
     }
+
+    auto const ret =
+        av_seek_frame(fmtc, videoStream, endPts, AVSEEK_FLAG_BACKWARD);
+    if (ret < 0) {
+      cerr << "Can't seek past cached GOP: " << AvErrorToString(ret) << endl;
+      return false;
+    }
+
+    FlushStreamQueues();
+    replayedGop.reset();
+    resumePts = endPts;
+    return false;
   }
 
-  if (ret < 0) {
+  auto const offset = replayedGop->offsets[replayedPacket];
+  auto const size = replayedGop->sizes[replayedPacket];
+  auto data = replayedGop->data.data() + offset;
+  videoBytes.insert(videoBytes.end(), data, data + size);
+  lastPacketData = replayedGop->packets[replayedPacket];
+  replayedPacket++;
+
+  return true;
+}
+
+/* Copies packet which was just demuxed to GOP being recorded;
+ * Keyframe completes previous GOP and starts new one;
+ */
+void FFmpegDemuxer::RecordPacket(size_t packetOffset) {
+  if (lastPacketData.flags & AV_PKT_FLAG_KEY) {
+    FinishRecording(lastPacketData.pts, false);
+    if (AV_NOPTS_VALUE != lastPacketData.pts) {
+      recordedGop = make_shared<CachedGop>();
+      recordedKeyPts = lastPacketData.pts;
+    }
+  }
+
+  if (!recordedGop) {
+    return;
+  }
+
+  auto &gop = *recordedGop;
+  auto const size = videoBytes.size() - packetOffset;
+  gop.offsets.push_back(gop.data.size());
+  gop.sizes.push_back(size);
+  gop.data.insert(gop.data.end(), videoBytes.begin() + packetOffset,
+                  videoBytes.end());
+  gop.packets.push_back(lastPacketData);
+
+  // GOP which doesn't fit into budget is never cached;
+  if (gop.SizeInBytes() > settings.gopCacheSize) {
+    recordedGop.reset();
+  }
+}
+
+void FFmpegDemuxer::FinishRecording(int64_t endPts, bool isLast) {
+  if (recordedGop && (isLast || endPts > recordedKeyPts)) {
+    recordedGop->endPts = endPts;
+    recordedGop->isLast = isLast;
+    GopCache::GetShared().Insert(cacheSource, recordedKeyPts, recordedGop);
+  }
+
+  recordedGop.reset();
+}
+
+bool FFmpegDemuxer::Demux(uint8_t *&pVideo, size_t &rVideoBytes) {
+  if (!fmtc) {
     return false;
   }
 
-  appendBytes(videoBytes, pkt, pktFiltered, bsfc, videoStream,
-              is_mp4H264 || is_mp4HEVC);
+  if (!videoBytes.empty()) {
+    videoBytes.clear();
+  }
+
+  interruptHandler.Arm(settings.readTimeout);
+  auto const res = DemuxPacket();
+  interruptHandler.Disarm();
+
+  if (!res) {
+    return false;
+  }
 
   pVideo = videoBytes.data();
   rVideoBytes = videoBytes.size();
 
-  // Update last packet data;
-  lastPacketData.dts = pktFiltered.dts;
-  lastPacketData.duration = pktFiltered.duration;
-  lastPacketData.pos = pktFiltered.pos;
-  lastPacketData.pts = pktFiltered.pts;
-
   return true;
 }
 
+bool FFmpegDemuxer::DemuxBatch(uint32_t maxPackets, size_t maxBytes,
+                               uint8_t *&pVideo, size_t &rVideoBytes,
+                               vector<PacketBatchEntry> &entries) {
+  entries.clear();
+  if (!fmtc) {
+    return false;
+  }
+
+  if (!videoBytes.empty()) {
+    videoBytes.clear();
+  }
+
+  interruptHandler.Arm(settings.readTimeout);
+  while (entries.size() < maxPackets && videoBytes.size() < maxBytes) {
+    auto const offset = videoBytes.size();
+    if (!DemuxPacket()) {
+      break;
+    }
+
+    PacketBatchEntry entry;
+    entry.offset = offset;
+    entry.size = videoBytes.size() - offset;
+    entry.pts = lastPacketData.pts;
+    entry.dts = lastPacketData.dts;
+    entry.duration = lastPacketData.duration;
+    entry.flags = lastPacketData.flags;
+    entries.push_back(entry);
+  }
+  interruptHandler.Disarm();
+
+  pVideo = videoBytes.data();
+  rVideoBytes = videoBytes.size();
+
+  return !entries.empty();
+}
+
 void FFmpegDemuxer::GetLastPacketData(PacketData &pktData) {
   pktData = lastPacketData;
 }
 
-int FFmpegDemuxer::ReadPacket(void *opaque, uint8_t *pBuf, int nBuf) {
-  return ((DataProvider *)opaque)->GetData(pBuf, nBuf);
+/* Returns next packet of given stream, either queued or read from container;
+ * Packets of other selected streams are queued, the rest are dropped;
+ */
+bool FFmpegDemuxer::ReadStreamPacket(int streamIndex, AVPacket &packet) {
+  auto &queue = streamQueues[streamIndex].packets;
+  if (!queue.empty()) {
+    auto queued = queue.front();
+    queue.pop_front();
+    av_packet_move_ref(&packet, queued);
+    av_packet_free(&queued);
+    return true;
+  }
+
+  int ret = 0;
+  while (true) {
+    avioTuner.BeginRead(fmtc->pb);
+    ret = av_read_frame(fmtc, &packet);
+    if (ret < 0) {
+      break;
+    }
+
+    // Bitrate is estimated against video timeline;
+    auto const isVideo = (packet.stream_index == videoStream);
+    avioTuner.EndRead(fmtc->pb, isVideo ? packet.dts : AV_NOPTS_VALUE,
+                      timebase);
+
+    if (packet.stream_index == streamIndex) {
+      return true;
+    }
+
+    auto it = streamQueues.find(packet.stream_index);
+    if (streamQueues.end() == it) {
+      av_packet_unref(&packet);
+      continue;
+    }
+
+    auto &otherQueue = it->second.packets;
+    if (otherQueue.size() >= settings.maxQueuedPackets) {
+      cerr << "Stream " << packet.stream_index
+           << " queue is full, dropping packet at " << otherQueue.front()->pos
+           << endl;
+      av_packet_free(&otherQueue.front());
+      otherQueue.pop_front();
+    }
+
+    auto queued = av_packet_alloc();
+    if (!queued) {
+      av_packet_unref(&packet);
+      return false;
+    }
+    av_packet_move_ref(queued, &packet);
+    otherQueue.push_back(queued);
+  }
+
+  /* Interrupted read leaves AVIO context in error state;
+   * Clear it so that caller may retry after timeout or interrupt;
+   */
+  if (AVERROR_EXIT == ret && fmtc->pb) {
+    fmtc->pb->eof_reached = 0;
+    fmtc->pb->error = 0;
+  }
+
+  return false;
 }
 
-AVCodecID FFmpegDemuxer::GetVideoCodec() const { return eVideoCodec; }
+void FFmpegDemuxer::FlushStreamQueues() {
+  for (auto &it : streamQueues) {
+    for (auto &queued : it.second.packets) {
+      av_packet_free(&queued);
+    }
+    it.second.packets.clear();
+  }
+}
+
+const vector<int> &FFmpegDemuxer::GetExtraStreams() const {
+  return extraStreams;
+}
+
+bool FFmpegDemuxer::DemuxStream(int streamIndex, uint8_t *&pData,
+                                size_t &rBytes) {
+  if (!fmtc || streamIndex == videoStream ||
+      streamQueues.end() == streamQueues.find(streamIndex)) {
+    return false;
+  }
+
+  if (streamPkt.data) {
+    av_packet_unref(&streamPkt);
+  }
+
+  interruptHandler.Arm(settings.readTimeout);
+  auto const res = ReadStreamPacket(streamIndex, streamPkt);
+  interruptHandler.Disarm();
+
+  if (!res) {
+    return false;
+  }
+
+  auto &packetData = streamQueues[streamIndex].lastPacketData;
+  packetData = PacketData();
+  packetData.pts = streamPkt.pts;
+  packetData.dts = streamPkt.dts;
+  packetData.pos = streamPkt.pos;
+  packetData.duration = streamPkt.duration;
+  packetData.flags = streamPkt.flags;
+
+  pData = streamPkt.data;
+  rBytes = streamPkt.size;
+
+  return true;
+}
+
+bool FFmpegDemuxer::GetAudioContext(int streamIndex,
+                                    AudioContext &audioContext) const {
+  auto it = streamQueues.find(streamIndex);
+  if (streamQueues.end() == it || streamIndex == videoStream) {
+    return false;
+  }
+
+  auto stream = fmtc->streams[streamIndex];
+  auto codecpar = stream->codecpar;
+
+  audioContext.streamIndex = streamIndex;
+  audioContext.codecId = codecpar->codec_id;
+  audioContext.sampleFormat = codecpar->format;
+  audioContext.sampleRate = codecpar->sample_rate;
+  audioContext.numChannels = codecpar->channels;
+  audioContext.channelLayout = codecpar->channel_layout;
+  audioContext.timeBase = av_q2d(stream->time_base);
+  audioContext.packetData = it->second.lastPacketData;
+
+  return true;
+}
+
+/* Parses "streams" setting; Streams which aren't selected are discarded, so
+ * libavformat doesn't spend time on them;
+ */
+void FFmpegDemuxer::SelectStreams() {
+  streamQueues[videoStream];
+
+  stringstream ss(settings.streams);
+  string token;
+  while (getline(ss, token, ',')) {
+    if (token.empty()) {
+      continue;
+    }
+
+    if ("audio" == token) {
+      for (auto i = 0U; i < fmtc->nb_streams; i++) {
+        if (AVMEDIA_TYPE_AUDIO == fmtc->streams[i]->codecpar->codec_type) {
+          streamQueues[i];
+        }
+      }
+      continue;
+    }
+
+    // Malformed index is reported below as out of range one;
+    int streamIndex = -1;
+    try {
+      streamIndex = stoi(token);
+    } catch (exception &) {
+    }
+
+    if (streamIndex < 0 || streamIndex >= (int)fmtc->nb_streams) {
+      stringstream err;
+      err << __FUNCTION__ << ": invalid stream " << token << endl;
+      throw invalid_argument(err.str());
+    }
+    streamQueues[streamIndex];
+  }
+
+  for (auto i = 0U; i < fmtc->nb_streams; i++) {
+    if (streamQueues.end() == streamQueues.find(i)) {
+      fmtc->streams[i]->discard = AVDISCARD_ALL;
+    } else if ((int)i != videoStream) {
+      extraStreams.push_back(i);
+    }
+  }
+}
+
+bool FFmpegDemuxer::Seek(double timestamp) {
+  if (!fmtc) {
+    return false;
+  }
+
+  auto const timeBase = fmtc->streams[videoStream]->time_base;
+  auto const ts = (int64_t)llround(timestamp / av_q2d(timeBase));
+
+  // Partially recorded GOP doesn't continue at new position;
+  recordedGop.reset();
+  resumePts = AV_NOPTS_VALUE;
+
+  auto gop = IsCacheable() ? GopCache::GetShared().Find(cacheSource, ts)
+                           : nullptr;
+  if (gop) {
+    if (pkt.data) {
+      av_packet_unref(&pkt);
+    }
+    replayedGop = gop;
+    replayedPacket = 0U;
+    is_EOF = false;
+    return true;
+  }
+
+  interruptHandler.Arm(settings.readTimeout);
+  auto const ret = av_seek_frame(fmtc, videoStream, ts, AVSEEK_FLAG_BACKWARD);
+  interruptHandler.Disarm();
+
+  if (ret < 0) {
+    cerr << "Can't seek to " << timestamp << ": " << AvErrorToString(ret)
+         << endl;
+    return false;
+  }
 
-FFmpegDemuxer::~FFmpegDemuxer() {
   if (pkt.data) {
     av_packet_unref(&pkt);
   }
-  if (pktFiltered.data) {
-    av_packet_unref(&pktFiltered);
+  FlushStreamQueues();
+  replayedGop.reset();
+
+  keyframeCounter = 0U;
+  lastSelectedTs = AV_NOPTS_VALUE;
+  pendingSeekTs = AV_NOPTS_VALUE;
+  is_EOF = false;
+
+  return true;
+}
+
+void FFmpegDemuxer::Interrupt() { interruptHandler.Interrupt(); }
+
+void FFmpegDemuxer::LinkInterrupt(const VPF::InterruptHandler *parent) {
+  interruptHandler.Link(parent);
+}
+
+bool FFmpegDemuxer::IsTimedOut() const { return interruptHandler.IsTimedOut(); }
+
+size_t FFmpegDemuxer::GetAvioBufferSize() const {
+  return (fmtc && fmtc->pb) ? fmtc->pb->buffer_size : 0U;
+}
+
+void FFmpegDemuxer::SetPacketFilter(const PacketFilter &filter) {
+  settings.packetFilter = filter;
+  recordedGop.reset();
+  keyframeCounter = 0U;
+  lastSelectedTs = AV_NOPTS_VALUE;
+  pendingSeekTs = AV_NOPTS_VALUE;
+}
+
+bool FFmpegDemuxer::IsSelected(const AVPacket &packet) {
+  auto &filter = settings.packetFilter;
+  if (FILTER_NONE == filter.mode) {
+    return true;
   }
 
-  if (bsfc) {
-    av_bsf_free(&bsfc);
+  if (!(packet.flags & AV_PKT_FLAG_KEY)) {
+    return false;
   }
 
-  avformat_close_input(&fmtc);
+  auto const ts = (AV_NOPTS_VALUE != packet.pts) ? packet.pts : packet.dts;
+  auto selected = true;
+
+  switch (filter.mode) {
+  case FILTER_NTH_KEYFRAME:
+    selected = (0U == keyframeCounter % max(1U, filter.keyframeStep));
+    keyframeCounter++;
+    break;
+  case FILTER_TIME_STRIDE:
+    selected = (AV_NOPTS_VALUE == lastSelectedTs) || (AV_NOPTS_VALUE == ts) ||
+               ((ts - lastSelectedTs) * timebase >= filter.timeStride);
+    break;
+  default:
+    break;
+  }
+
+  if (selected) {
+    lastSelectedTs = ts;
+  }
+
+  return selected;
+}
+
+static int GetNumIndexEntries(AVStream *stream) {
+#if LIBAVFORMAT_VERSION_INT >= AV_VERSION_INT(58, 78, 100)
+  return avformat_index_get_entries_count(stream);
+#else
+  return stream->nb_index_entries;
+#endif
+}
+
+static const AVIndexEntry *GetIndexEntry(AVStream *stream, int idx) {
+#if LIBAVFORMAT_VERSION_INT >= AV_VERSION_INT(58, 78, 100)
+  return avformat_index_get_entry(stream, idx);
+#else
+  return (idx >= 0 && idx < stream->nb_index_entries)
+             ? stream->index_entries + idx
+             : nullptr;
+#endif
+}
+
+/* Looks up container index for next keyframe which passes the filter;
+ * If there's no index, packets are read one by one and filtered;
+ */
+void FFmpegDemuxer::ScheduleSeekToNextSelected(const AVPacket &packet) {
+  auto stream = fmtc->streams[videoStream];
+  if (!GetNumIndexEntries(stream) || AV_NOPTS_VALUE == packet.dts) {
+    return;
+  }
+
+  auto &filter = settings.packetFilter;
+  int64_t targetTs = packet.dts + 1;
+  if (FILTER_TIME_STRIDE == filter.mode && timebase > 0.0) {
+    targetTs = packet.dts + max<int64_t>(1, filter.timeStride / timebase);
+  }
+
+  // Index search without AVSEEK_FLAG_BACKWARD gives keyframe at or after ts;
+  auto idx = av_index_search_timestamp(stream, targetTs, 0);
+  if (FILTER_NTH_KEYFRAME == filter.mode) {
+    for (auto i = 1U; i < filter.keyframeStep && idx >= 0; i++) {
+      auto entry = GetIndexEntry(stream, idx);
+      idx = entry ? av_index_search_timestamp(stream, entry->timestamp + 1, 0)
+                  : -1;
+    }
+  }
+
+  auto entry = GetIndexEntry(stream, idx);
+  if (!entry) {
+    return;
+  }
+
+  /* Don't seek if next selected keyframe is close enough, e. g. when every
+   * frame is a keyframe. Sequential read is cheaper then;
+   */
+  auto nextIdx = av_index_search_timestamp(stream, packet.dts + 1, 0);
+  if (nextIdx == idx && entry->pos - packet.pos <= packet.size) {
+    return;
+  }
+
+  pendingSeekTs = entry->timestamp;
+}
+
+int FFmpegDemuxer::ReadPacket(void *opaque, uint8_t *pBuf, int nBuf) {
+  auto pThis = (FFmpegDemuxer *)opaque;
+  if (VPF::InterruptHandler::Callback(&pThis->interruptHandler)) {
+    return AVERROR_EXIT;
+  }
+  return pThis->avioProvider->GetData(pBuf, nBuf);
+}
+
+int64_t FFmpegDemuxer::SeekPacket(void *opaque, int64_t offset, int whence) {
+  auto pThis = (FFmpegDemuxer *)opaque;
+  if (AVSEEK_SIZE != whence &&
+      VPF::InterruptHandler::Callback(&pThis->interruptHandler)) {
+    return AVERROR_EXIT;
+  }
+  return pThis->avioProvider->Seek(offset, whence);
+}
+
+AVCodecID FFmpegDemuxer::GetVideoCodec() const { return eVideoCodec; }
+
+FFmpegDemuxer::~FFmpegDemuxer() {
+  Close();
 
   if (avioc) {
     av_freep(&avioc->buffer);
@@ -167,24 +953,52 @@ FFmpegDemuxer::~FFmpegDemuxer() {
   }
 }
 
+// Same as libavformat IO_BUFFER_SIZE;
+static const int defaultAvioBufferSize = 32 * 1024;
+
 AVFormatContext *
 FFmpegDemuxer::CreateFormatContext(DataProvider *pDataProvider,
                                    const map<string, string> &ffmpeg_options) {
+  InitLibavformat();
+
   AVFormatContext *ctx = avformat_alloc_context();
   if (!ctx) {
     cerr << "Can't allocate AVFormatContext at " << __FILE__ << " " << __LINE__;
     return nullptr;
   }
+  interruptHandler.Install(ctx);
 
+  /* AVIO buffer is kept when demuxer is reopened. It may have been resized by
+   * libavformat, so actual size is taken from context;
+   * Own providers stand in for libavformat protocols, so they get its default
+   * buffer size. Caller ones keep large buffer as their reads may be costly;
+   */
   uint8_t *avioc_buffer = nullptr;
-  int avioc_buffer_size = 8 * 1024 * 1024;
-  avioc_buffer = (uint8_t *)av_malloc(avioc_buffer_size);
+  int avioc_buffer_size = (pDataProvider == ownProvider.get())
+                              ? defaultAvioBufferSize
+                              : 8 * 1024 * 1024;
+  if (settings.avioBufferSize) {
+    avioc_buffer_size = settings.avioBufferSize;
+  } else if (settings.avioAdaptive) {
+    avioc_buffer_size = VPF::AvioBufferTuner::minBufferSize;
+  }
+
+  if (avioc) {
+    avioc_buffer = avioc->buffer;
+    avioc_buffer_size = avioc->buffer_size;
+    av_freep(&avioc);
+  } else {
+    avioc_buffer = (uint8_t *)av_malloc(avioc_buffer_size);
+  }
+
   if (!avioc_buffer) {
     cerr << "Can't allocate avioc_buffer at " << __FILE__ << " " << __LINE__;
     return nullptr;
   }
-  avioc = avio_alloc_context(avioc_buffer, avioc_buffer_size, 0, pDataProvider,
-                             &ReadPacket, nullptr, nullptr);
+  avioProvider = pDataProvider;
+  avioc = avio_alloc_context(
+      avioc_buffer, avioc_buffer_size, 0, this, &ReadPacket, nullptr,
+      pDataProvider->IsSeekable() ? &SeekPacket : nullptr);
 
   if (!avioc) {
     cerr << "Can't allocate AVIOContext at " << __FILE__ << " " << __LINE__;
@@ -204,8 +1018,13 @@ FFmpegDemuxer::CreateFormatContext(DataProvider *pDataProvider,
     }
   }
 
+  // Deadline is disarmed in Init() as streams probing is also covered;
+  interruptHandler.Arm(settings.openTimeout);
   auto err = avformat_open_input(&ctx, nullptr, nullptr, &options);
   if (0 != err) {
+    if (interruptHandler.IsTimedOut()) {
+      throw VPF::TimeoutException("Input opening timed out");
+    }
     cerr << "Can't open input. Error message: " << AvErrorToString(err);
     return nullptr;
   }
@@ -216,7 +1035,29 @@ FFmpegDemuxer::CreateFormatContext(DataProvider *pDataProvider,
 AVFormatContext *
 FFmpegDemuxer::CreateFormatContext(const char *szFilePath,
                                    const map<string, string> &ffmpeg_options) {
-  avformat_network_init();
+  InitLibavformat();
+
+  if (settings.ioUring) {
+#ifdef USE_IO_URING
+    /* Anything but local file is opened by libavformat as usual;
+     * Only provider construction falls back, opening errors and timeouts
+     * are given to caller;
+     */
+    try {
+      ownProvider.reset(
+          new UringDataProvider(szFilePath, UringService::GetShared()));
+    } catch (exception &e) {
+      ownProvider.reset();
+      cerr << e.what() << endl;
+    }
+
+    if (ownProvider) {
+      return CreateFormatContext(ownProvider.get(), ffmpeg_options);
+    }
+#else
+    cerr << "VPF is built without io_uring support, option is ignored" << endl;
+#endif
+  }
 
   // Set up format context options;
   AVDictionary *options = NULL;
@@ -231,20 +1072,187 @@ FFmpegDemuxer::CreateFormatContext(const char *szFilePath,
     }
   }
 
-  AVFormatContext *ctx = nullptr;
-  av_register_all();
+  AVFormatContext *ctx = avformat_alloc_context();
+  if (!ctx) {
+    cerr << "Can't allocate AVFormatContext at " << __FILE__ << " " << __LINE__;
+    return nullptr;
+  }
+  interruptHandler.Install(ctx);
+
+  // Deadline is disarmed in Init() as streams probing is also covered;
+  interruptHandler.Arm(settings.openTimeout);
   auto err = avformat_open_input(&ctx, szFilePath, nullptr, &options);
   if (err < 0) {
+    if (interruptHandler.IsTimedOut()) {
+      stringstream ss;
+      ss << "Opening " << szFilePath << " timed out" << endl;
+      throw VPF::TimeoutException(ss.str());
+    }
     cerr << "Can't open " << szFilePath << ": " << AvErrorToString(err) << "\n";
     return nullptr;
   }
 
+  // Inputs which aren't read through AVIO (e. g. RTSP) have no pb;
+  if (settings.avioBufferSize && ctx->pb) {
+    VPF::AvioBufferTuner::Resize(ctx->pb, settings.avioBufferSize);
+  }
+
   return ctx;
 }
 
-FFmpegDemuxer::FFmpegDemuxer(AVFormatContext *fmtcx) : fmtc(fmtcx) {
+static AVPixelFormat SpsToPixelFormat(const SpsInfo &spsInfo) {
+  auto const is8bit = (8U == spsInfo.bitDepthLuma);
+  auto const is10bit = (10U == spsInfo.bitDepthLuma);
+
+  switch (spsInfo.chromaFormatIdc) {
+  case 0:
+    return is8bit ? AV_PIX_FMT_GRAY8 : AV_PIX_FMT_NONE;
+  case 1:
+    return is8bit ? AV_PIX_FMT_YUV420P
+                  : is10bit ? AV_PIX_FMT_YUV420P10LE : AV_PIX_FMT_NONE;
+  case 2:
+    return is8bit ? AV_PIX_FMT_YUV422P
+                  : is10bit ? AV_PIX_FMT_YUV422P10LE : AV_PIX_FMT_NONE;
+  case 3:
+    return is8bit ? AV_PIX_FMT_YUV444P
+                  : is10bit ? AV_PIX_FMT_YUV444P10LE : AV_PIX_FMT_NONE;
+  default:
+    return AV_PIX_FMT_NONE;
+  }
+}
+
+// Upper limit of packets read by fast open in search for in-band SPS;
+static const size_t maxSpsProbePackets = 256U;
+
+/* Reads packets until video one with SPS shows up. That's the case for
+ * MPEG-TS and raw Annex.B inputs, which have no extradata;
+ * Packets which are read are kept, they are queued once streams are
+ * selected;
+ */
+bool FFmpegDemuxer::FindInbandSps(int streamIndex, bool isHEVC,
+                                  SpsInfo &spsInfo) {
+  while (probedPackets.size() < maxSpsProbePackets) {
+    auto packet = av_packet_alloc();
+    if (!packet) {
+      return false;
+    }
+
+    if (av_read_frame(fmtc, packet) < 0) {
+      av_packet_free(&packet);
+      return false;
+    }
+    probedPackets.push_back(packet);
+
+    if (packet->stream_index != streamIndex) {
+      continue;
+    }
+
+    // Annex.B packet is parsed the same way as Annex.B extradata;
+    ParameterSets paramSets;
+    if (ParseExtradata(packet->data, packet->size, isHEVC, paramSets)) {
+      auto &sps = paramSets.sps.front();
+      return isHEVC ? ParseHEVCSps(sps.data(), sps.size(), spsInfo)
+                    : ParseH264Sps(sps.data(), sps.size(), spsInfo);
+    }
+  }
+
+  return false;
+}
+
+// Packets of streams which aren't selected are dropped;
+void FFmpegDemuxer::QueueProbedPackets() {
+  for (auto &probed : probedPackets) {
+    auto it = streamQueues.find(probed->stream_index);
+    if (streamQueues.end() == it) {
+      av_packet_free(&probed);
+    } else {
+      it->second.packets.push_back(probed);
+    }
+  }
+  probedPackets.clear();
+}
+
+/* Fills video stream codec parameters from container headers, SPS from
+ * extradata or the first in-band one, or cached parameters (in that order
+ * of preference);
+ * Returns false if avformat_find_stream_info is still needed;
+ */
+bool FFmpegDemuxer::FastOpen() {
+  auto streamIdx =
+      av_find_best_stream(fmtc, AVMEDIA_TYPE_VIDEO, -1, -1, nullptr, 0);
+  if (streamIdx < 0) {
+    return false;
+  }
+
+  auto stream = fmtc->streams[streamIdx];
+  auto codecpar = stream->codecpar;
+
+  if (AV_CODEC_ID_NONE == codecpar->codec_id) {
+    codecpar->codec_id = settings.cachedCodec;
+  }
+
+  SpsInfo spsInfo;
+  bool hasSps = false;
+  auto const isH264 = (AV_CODEC_ID_H264 == codecpar->codec_id);
+  auto const isHEVC = (AV_CODEC_ID_HEVC == codecpar->codec_id);
+
+  if (isH264 || isHEVC) {
+    ParameterSets paramSets;
+    if (ParseExtradata(codecpar->extradata, codecpar->extradata_size, isHEVC,
+                       paramSets)) {
+      auto &sps = paramSets.sps.front();
+      hasSps = isHEVC ? ParseHEVCSps(sps.data(), sps.size(), spsInfo)
+                      : ParseH264Sps(sps.data(), sps.size(), spsInfo);
+    }
+
+    auto const needsSps = !codecpar->width || !codecpar->height ||
+                          AV_PIX_FMT_NONE == codecpar->format;
+    if (!hasSps && needsSps) {
+      hasSps = FindInbandSps(streamIdx, isHEVC, spsInfo);
+    }
+  }
+
+  if (!codecpar->width || !codecpar->height) {
+    codecpar->width = hasSps ? spsInfo.width : settings.cachedWidth;
+    codecpar->height = hasSps ? spsInfo.height : settings.cachedHeight;
+  }
+
+  if (AV_PIX_FMT_NONE == codecpar->format && hasSps) {
+    codecpar->format = SpsToPixelFormat(spsInfo);
+  }
+
+  if (!stream->r_frame_rate.num || !stream->r_frame_rate.den) {
+    if (stream->avg_frame_rate.num && stream->avg_frame_rate.den) {
+      stream->r_frame_rate = stream->avg_frame_rate;
+    } else if (hasSps && spsInfo.frameRate > 0.0) {
+      stream->r_frame_rate = av_d2q(spsInfo.frameRate, 1000000);
+    } else if (settings.cachedFramerate > 0.0) {
+      stream->r_frame_rate = av_d2q(settings.cachedFramerate, 1000000);
+    }
+  }
+
+  return (AV_CODEC_ID_NONE != codecpar->codec_id) && codecpar->width &&
+         codecpar->height && stream->r_frame_rate.num &&
+         stream->r_frame_rate.den;
+}
+
+void FFmpegDemuxer::Init(AVFormatContext *fmtcx) {
+  fmtc = fmtcx;
   pkt = {};
-  pktFiltered = {};
+  streamPkt = {};
+  lastPacketData = {};
+  keyframeCounter = 0U;
+  lastSelectedTs = AV_NOPTS_VALUE;
+  pendingSeekTs = AV_NOPTS_VALUE;
+  videoStream = -1;
+  isNalStream = false;
+  isAnnexBNeeded = false;
+  is_EOF = false;
+  recordedGop.reset();
+  replayedGop.reset();
+  resumePts = AV_NOPTS_VALUE;
+  avioTuner.Configure(settings.avioAdaptive, settings.avioMaxBufferSize,
+                      settings.avioBufferDuration);
 
   if (!fmtc) {
     stringstream ss;
@@ -252,14 +1260,23 @@ FFmpegDemuxer::FFmpegDemuxer(AVFormatContext *fmtcx) : fmtc(fmtcx) {
     throw invalid_argument(ss.str());
   }
 
-  auto ret = avformat_find_stream_info(fmtc, nullptr);
-  if (0 != ret) {
-    stringstream ss;
-    ss << __FUNCTION__ << ": can't find stream info;" << AvErrorToString(ret)
-       << endl;
-    throw runtime_error(ss.str());
+  int ret = 0;
+  if (!settings.fastOpen || !FastOpen()) {
+    ret = avformat_find_stream_info(fmtc, nullptr);
+    if (0 != ret && interruptHandler.IsTimedOut()) {
+      stringstream ss;
+      ss << __FUNCTION__ << ": streams probing timed out" << endl;
+      throw VPF::TimeoutException(ss.str());
+    } else if (0 != ret) {
+      stringstream ss;
+      ss << __FUNCTION__ << ": can't find stream info;" << AvErrorToString(ret)
+         << endl;
+      throw runtime_error(ss.str());
+    }
   }
 
+  interruptHandler.Disarm();
+
   videoStream =
       av_find_best_stream(fmtc, AVMEDIA_TYPE_VIDEO, -1, -1, nullptr, 0);
   if (videoStream < 0) {
@@ -277,38 +1294,45 @@ FFmpegDemuxer::FFmpegDemuxer(AVFormatContext *fmtcx) : fmtc(fmtcx) {
              (double)fmtc->streams[videoStream]->time_base.den;
   eChromaFormat = (AVPixelFormat)fmtc->streams[videoStream]->codecpar->format;
 
-  is_mp4H264 = (eVideoCodec == AV_CODEC_ID_H264);
-  is_mp4HEVC = (eVideoCodec == AV_CODEC_ID_HEVC);
   av_init_packet(&pkt);
   pkt.data = nullptr;
   pkt.size = 0;
-  av_init_packet(&pktFiltered);
-  pktFiltered.data = nullptr;
-  pktFiltered.size = 0;
 
-  const string bfs_name = is_mp4H264
-                              ? "h264_mp4toannexb"
-                              : is_mp4HEVC ? "hevc_mp4toannexb" : "unknown";
-  const AVBitStreamFilter *bsf = av_bsf_get_by_name(bfs_name.c_str());
-  if (!bsf) {
-    throw runtime_error("can't get " + bfs_name + " filter by name");
-  }
-  ret = av_bsf_alloc(bsf, &bsfc);
-  if (0 != ret) {
-    throw runtime_error("Error allocating " + bfs_name +
-                        " filter: " + AvErrorToString(ret));
-  }
+  av_init_packet(&streamPkt);
+  streamPkt.data = nullptr;
+  streamPkt.size = 0;
+
+  SelectStreams();
+  QueueProbedPackets();
 
-  ret = avcodec_parameters_copy(bsfc->par_in,
-                                fmtc->streams[videoStream]->codecpar);
-  if (0 != ret) {
-    throw runtime_error("Error copying codec parameters: " +
-                        AvErrorToString(ret));
+  /* Length-prefixed H.264 / HEVC is converted to Annex.B unless it's
+   * explicitly disabled. Converter passes packets through if they are in
+   * Annex.B already. It's initialized anyway as NAL parser needs to know
+   * NAL unit length prefix size;
+   */
+  auto const isH264 = (AV_CODEC_ID_H264 == eVideoCodec);
+  auto const isHEVC = (AV_CODEC_ID_HEVC == eVideoCodec);
+  auto codecpar = fmtc->streams[videoStream]->codecpar;
+  isNalStream = isH264 || isHEVC;
+  if (isNalStream) {
+    annexbConverter.Init(codecpar->extradata, codecpar->extradata_size,
+                         isHEVC);
+    isAnnexBNeeded = settings.annexb && !annexbConverter.IsPassthrough();
+    nalParser = VPF::NalParser(isHEVC);
+    nalParser.SetExtradata(codecpar->extradata, codecpar->extradata_size);
   }
 
-  ret = av_bsf_init(bsfc);
-  if (0 != ret) {
-    throw runtime_error("Error initializing " + bfs_name +
-                        " bitstream filter: " + AvErrorToString(ret));
+  /* Cached packets are stored as they are given to user, so settings which
+   * affect that are part of the key;
+   */
+  if (settings.gopCacheSize && !cacheSource.empty()) {
+    auto &cache = GopCache::GetShared();
+    if (cache.GetByteBudget() < settings.gopCacheSize) {
+      cache.SetByteBudget(settings.gopCacheSize);
+    }
+
+    stringstream ss;
+    ss << "#annexb=" << isAnnexBNeeded << "#nal_info=" << settings.nalInfo;
+    cacheSource += ss.str();
   }
-}
\ No newline at end of file
+}
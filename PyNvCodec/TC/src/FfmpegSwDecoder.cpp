@@ -11,17 +11,34 @@
  * limitations under the License.
  */
 
+#include "InterruptHandler.hpp"
 #include "Tasks.hpp"
+#include <algorithm>
+#include <cmath>
+#include <condition_variable>
+#include <cstdlib>
+#include <deque>
+#include <functional>
 #include <iostream>
+#include <limits>
+#include <memory>
+#include <mutex>
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
 #include <sstream>
 #include <stdexcept>
 #include <string>
+#include <thread>
 #include <vector>
 
 extern "C" {
 #include <libavformat/avformat.h>
 #include <libavutil/error.h>
+#include <libavutil/imgutils.h>
 #include <libavutil/motion_vector.h>
+#include <libavutil/pixdesc.h>
 }
 
 using namespace VPF;
@@ -46,6 +63,541 @@ static string AvErrorToString(int av_error_code) {
   return str;
 }
 
+/* Removes option from dictionary;
+ * Returns false if there's no such option;
+ */
+static bool TakeOption(AVDictionary **pOptions, const char *key,
+                       string &value) {
+  auto entry = av_dict_get(*pOptions, key, nullptr, 0);
+  if (!entry) {
+    return false;
+  }
+
+  value = entry->value;
+  av_dict_set(pOptions, key, nullptr, 0);
+  return true;
+}
+
+/* Removes option from dictionary and returns its value in seconds;
+ * Zero is returned if there's no such option;
+ */
+static double TakeTimeout(AVDictionary **pOptions, const char *key) {
+  string value;
+  return TakeOption(pOptions, key, value) ? atof(value.c_str()) : 0.0;
+}
+
+/* Decoder threading settings which are handled by VPF itself;
+ * Unless given, libavcodec defaults are used;
+ */
+struct ThreadingSettings {
+  // Number of decoder threads, zero stands for one per CPU core;
+  int threadCount = -1;
+  // FF_THREAD_FRAME and / or FF_THREAD_SLICE;
+  int threadType = -1;
+  // Comma-separated list of CPU indices or ranges, e. g. "0-3,8";
+  string affinity;
+};
+
+static ThreadingSettings TakeThreadingSettings(AVDictionary **pOptions) {
+  ThreadingSettings threading;
+  string value;
+
+  try {
+    if (TakeOption(pOptions, "threads", value)) {
+      threading.threadCount = ("auto" == value) ? 0 : stoi(value);
+      if (threading.threadCount < 0) {
+        throw invalid_argument("negative thread count");
+      }
+    }
+
+    if (TakeOption(pOptions, "thread_type", value)) {
+      if ("frame" == value) {
+        threading.threadType = FF_THREAD_FRAME;
+      } else if ("slice" == value) {
+        threading.threadType = FF_THREAD_SLICE;
+      } else if ("frame+slice" == value || "slice+frame" == value) {
+        threading.threadType = FF_THREAD_FRAME | FF_THREAD_SLICE;
+      } else {
+        throw invalid_argument("unknown thread type");
+      }
+    }
+  } catch (exception &e) {
+    stringstream ss;
+    ss << "Invalid decoder option value " << value << ": " << e.what()
+       << endl;
+    throw invalid_argument(ss.str());
+  }
+
+  TakeOption(pOptions, "thread_affinity", threading.affinity);
+  return threading;
+}
+
+/* Decoding shortcuts which trade picture quality for speed;
+ * They're read by decoder on every frame, so they may be changed between
+ * calls. Frame threads pick them up as well;
+ */
+static const char *skipOptions[] = {"skip_frame", "skip_loop_filter",
+                                    "skip_idct", "fast"};
+
+static AVDiscard ParseDiscard(const string &value) {
+  if ("none" == value) {
+    return AVDISCARD_NONE;
+  } else if ("default" == value) {
+    return AVDISCARD_DEFAULT;
+  } else if ("nonref" == value || "noref" == value) {
+    return AVDISCARD_NONREF;
+  } else if ("bidir" == value) {
+    return AVDISCARD_BIDIR;
+  } else if ("nonintra" == value || "nointra" == value) {
+    return AVDISCARD_NONINTRA;
+  } else if ("nonkey" == value || "nokey" == value) {
+    return AVDISCARD_NONKEY;
+  } else if ("all" == value) {
+    return AVDISCARD_ALL;
+  }
+
+  stringstream ss;
+  ss << "Invalid discard policy " << value << endl;
+  throw invalid_argument(ss.str());
+}
+
+// Returns false if option isn't one of skipOptions;
+static bool SetSkipOption(AVCodecContext *avctx, const string &key,
+                          const string &value) {
+  if ("skip_frame" == key) {
+    avctx->skip_frame = ParseDiscard(value);
+  } else if ("skip_loop_filter" == key) {
+    avctx->skip_loop_filter = ParseDiscard(value);
+  } else if ("skip_idct" == key) {
+    avctx->skip_idct = ParseDiscard(value);
+  } else if ("fast" == key) {
+    if (0 != atoi(value.c_str())) {
+      avctx->flags2 |= AV_CODEC_FLAG2_FAST;
+    } else {
+      avctx->flags2 &= ~AV_CODEC_FLAG2_FAST;
+    }
+  } else {
+    return false;
+  }
+
+  return true;
+}
+
+#if defined(__linux__)
+static cpu_set_t ParseCpuList(const string &cpuList) {
+  cpu_set_t cpus;
+  CPU_ZERO(&cpus);
+
+  stringstream ss(cpuList);
+  string token;
+  while (getline(ss, token, ',')) {
+    if (token.empty()) {
+      continue;
+    }
+
+    int first = -1, last = -1;
+    try {
+      auto const dash = token.find('-');
+      first = stoi(token.substr(0, dash));
+      last = (string::npos == dash) ? first : stoi(token.substr(dash + 1));
+    } catch (exception &) {
+    }
+
+    if (first < 0 || last < first || last >= CPU_SETSIZE) {
+      stringstream err;
+      err << "Invalid thread affinity " << cpuList << endl;
+      throw invalid_argument(err.str());
+    }
+
+    for (auto cpu = first; cpu <= last; cpu++) {
+      CPU_SET(cpu, &cpus);
+    }
+  }
+
+  return cpus;
+}
+#endif
+
+/* Decoder threads are spawned by avcodec_open2() and inherit affinity of
+ * calling thread. So affinity is set for the time codec is opened and
+ * restored afterwards;
+ */
+static int OpenCodec(AVCodecContext *avctx, AVCodec *p_codec,
+                     AVDictionary **pOptions, const string &affinity) {
+  if (affinity.empty()) {
+    return avcodec_open2(avctx, p_codec, pOptions);
+  }
+
+#if defined(__linux__)
+  auto const cpus = ParseCpuList(affinity);
+  auto const self = pthread_self();
+
+  cpu_set_t callerCpus;
+  if (0 != pthread_getaffinity_np(self, sizeof(callerCpus), &callerCpus) ||
+      0 != pthread_setaffinity_np(self, sizeof(cpus), &cpus)) {
+    cerr << "Can't set decoder threads affinity to " << affinity << endl;
+    return avcodec_open2(avctx, p_codec, pOptions);
+  }
+
+  auto const res = avcodec_open2(avctx, p_codec, pOptions);
+  pthread_setaffinity_np(self, sizeof(callerCpus), &callerCpus);
+  return res;
+#else
+  cerr << "Decoder threads affinity isn't supported on this platform" << endl;
+  return avcodec_open2(avctx, p_codec, pOptions);
+#endif
+}
+
+/* Pixel formats which decoded frames are saved in;
+ * Returns UNDEFINED for those which aren't supported;
+ */
+static Pixel_Format ToPixelFormat(AVPixelFormat format) {
+  switch (format) {
+  case AV_PIX_FMT_YUV420P:
+  case AV_PIX_FMT_YUVJ420P:
+    return YUV420;
+  case AV_PIX_FMT_NV12:
+    return NV12;
+  case AV_PIX_FMT_YUV422P:
+  case AV_PIX_FMT_YUVJ422P:
+    return YUV422;
+  case AV_PIX_FMT_YUV444P:
+  case AV_PIX_FMT_YUVJ444P:
+    return YUV444;
+  case AV_PIX_FMT_P010LE:
+    return P10;
+  case AV_PIX_FMT_YUV420P10LE:
+    return YUV420_10bit;
+  default:
+    return UNDEFINED;
+  }
+}
+
+#if LIBAVUTIL_VERSION_MAJOR < 57
+typedef int PoolBufferSize;
+#else
+typedef size_t PoolBufferSize;
+#endif
+
+static void FreePoolBuffer(void *opaque, uint8_t *) {
+  delete (Buffer *)opaque;
+}
+
+// Called from decoder threads, mustn't throw;
+static AVBufferRef *AllocPoolBuffer(void *, PoolBufferSize size) {
+  Buffer *buffer = nullptr;
+  try {
+    buffer = Buffer::MakeOwnMem(size);
+  } catch (exception &) {
+    return nullptr;
+  }
+
+  auto ref = av_buffer_create(buffer->GetDataAs<uint8_t>(), size,
+                              &FreePoolBuffer, buffer, 0);
+  if (!ref) {
+    delete buffer;
+  }
+  return ref;
+}
+
+/* Pool of VPF Buffers which libavcodec decodes into;
+ * Pool is re-created when frame size changes. Buffers of old pool are
+ * released as soon as decoder drops last reference to them;
+ */
+struct FrameBufferPool {
+  mutex pool_mutex;
+  AVBufferPool *pool = nullptr;
+  int pool_size = 0;
+
+  AVBufferRef *Get(int size) {
+    lock_guard<mutex> lock(pool_mutex);
+    if (!pool || size != pool_size) {
+      av_buffer_pool_uninit(&pool);
+      pool = av_buffer_pool_init2(size, nullptr, &AllocPoolBuffer, nullptr);
+      pool_size = size;
+    }
+
+    return pool ? av_buffer_pool_get(pool) : nullptr;
+  }
+
+  ~FrameBufferPool() { av_buffer_pool_uninit(&pool); }
+};
+
+/* Tells if planes may lie back to back without padding, so that FramePacker
+ * gives them away without copy;
+ * It's only possible if codec doesn't need extra rows or columns and packed
+ * pitch meets its alignment. H.264 always needs extra rows, as do most
+ * frame sizes which aren't multiple of 32 rows, so these are copied;
+ */
+static bool CanPack(AVPixelFormat format, int width, int height,
+                    int aligned_width, int aligned_height,
+                    const int *linesize_align, int *linesize) {
+  if (width != aligned_width || height != aligned_height) {
+    return false;
+  }
+
+  if (av_image_fill_linesizes(linesize, format, width) < 0) {
+    return false;
+  }
+
+  for (auto i = 0; i < 4; i++) {
+    if (linesize[i] % linesize_align[i]) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+/* get_buffer2() callback, gives decoder a pooled Buffer with alignment and
+ * padding libavcodec asks for. Packed layout is used when codec allows it.
+ * Formats which aren't saved go to default allocator;
+ */
+static int GetFrameBuffer(AVCodecContext *avctx, AVFrame *frame, int flags) {
+  auto const format = (AVPixelFormat)frame->format;
+  if (!(avctx->codec->capabilities & AV_CODEC_CAP_DR1) ||
+      UNDEFINED == ToPixelFormat(format)) {
+    return avcodec_default_get_buffer2(avctx, frame, flags);
+  }
+
+  int width = frame->width;
+  int height = frame->height;
+  int linesize_align[AV_NUM_DATA_POINTERS];
+  avcodec_align_dimensions2(avctx, &width, &height, linesize_align);
+
+  int linesize[4] = {0};
+  if (!CanPack(format, frame->width, frame->height, width, height,
+               linesize_align, linesize)) {
+    // Same stride search as libavcodec default allocator does;
+    int unaligned = 0;
+    do {
+      auto res = av_image_fill_linesizes(linesize, format, width);
+      if (res < 0) {
+        return res;
+      }
+
+      width += width & ~(width - 1);
+      unaligned = 0;
+      for (auto i = 0; i < 4; i++) {
+        unaligned |= linesize[i] % linesize_align[i];
+      }
+    } while (unaligned);
+  }
+
+  uint8_t *data[4] = {nullptr};
+  auto const size =
+      av_image_fill_pointers(data, format, height, nullptr, linesize);
+  if (size < 0) {
+    return size;
+  }
+
+  // Some SIMD functions read past the end of last plane;
+  auto pool = (FrameBufferPool *)avctx->opaque;
+  frame->buf[0] = pool->Get(size + 16 + 64 - 1);
+  if (!frame->buf[0]) {
+    return AVERROR(ENOMEM);
+  }
+
+  av_image_fill_pointers(frame->data, format, height, frame->buf[0]->data,
+                         linesize);
+  for (auto i = 0; i < 4; i++) {
+    frame->linesize[i] = linesize[i];
+  }
+  frame->extended_data = frame->data;
+
+  return 0;
+}
+
+// Tells if frame planes lie back to back without padding;
+static bool IsPacked(AVFrame *frame, size_t size) {
+  auto const format = (AVPixelFormat)frame->format;
+  auto const buf = frame->buf[0];
+  if (!buf || frame->buf[1] || frame->data[0] < buf->data ||
+      frame->data[0] + size > buf->data + buf->size) {
+    return false;
+  }
+
+  int linesize[4] = {0};
+  uint8_t *data[4] = {nullptr};
+  av_image_fill_linesizes(linesize, format, frame->width);
+  av_image_fill_pointers(data, format, frame->height, frame->data[0],
+                         linesize);
+
+  for (auto i = 0; i < av_pix_fmt_count_planes(format); i++) {
+    if (data[i] != frame->data[i] || linesize[i] != frame->linesize[i]) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+/* Averages factor x factor blocks of plane samples;
+ * Samples of interleaved planes (e. g. NV12 chroma) are averaged component
+ * by component. Blocks at right and bottom edges may be partial;
+ */
+template <typename T>
+static void DecimatePlane(const uint8_t *src, int src_pitch, int src_width,
+                          int src_height, uint8_t *dst, int dst_width,
+                          int dst_height, int num_comps, int factor) {
+  auto out = (T *)dst;
+  for (auto y = 0; y < dst_height; y++) {
+    auto const y0 = y * factor;
+    auto const y1 = min(y0 + factor, src_height);
+
+    for (auto x = 0; x < dst_width; x++) {
+      auto const x0 = x * factor;
+      auto const x1 = min(x0 + factor, src_width);
+      auto const count = (y1 - y0) * (x1 - x0);
+
+      for (auto c = 0; c < num_comps; c++) {
+        uint32_t sum = 0U;
+        for (auto sy = y0; sy < y1; sy++) {
+          auto row = (const T *)(src + sy * src_pitch);
+          for (auto sx = x0; sx < x1; sx++) {
+            sum += row[sx * num_comps + c];
+          }
+        }
+        *out++ = (T)((sum + count / 2) / count);
+      }
+    }
+  }
+}
+
+// Decimating counterpart of av_image_copy_to_buffer();
+static bool DecimateToBuffer(AVFrame *frame, uint8_t *dst, int dst_width,
+                             int dst_height, int factor) {
+  auto const format = (AVPixelFormat)frame->format;
+  auto const desc = av_pix_fmt_desc_get(format);
+  if (!desc) {
+    return false;
+  }
+
+  auto const sample_size = desc->comp[0].depth > 8 ? 2 : 1;
+  for (auto plane = 0; plane < av_pix_fmt_count_planes(format); plane++) {
+    // Pixel step within the plane tells if components are interleaved;
+    auto step = sample_size;
+    for (auto i = 0; i < desc->nb_components; i++) {
+      if (desc->comp[i].plane == plane) {
+        step = desc->comp[i].step;
+      }
+    }
+    auto const num_comps = max(1, step / sample_size);
+
+    auto const is_chroma = (1 == plane || 2 == plane);
+    auto const shift_w = is_chroma ? desc->log2_chroma_w : 0;
+    auto const shift_h = is_chroma ? desc->log2_chroma_h : 0;
+    auto const src_width = AV_CEIL_RSHIFT(frame->width, shift_w);
+    auto const src_height = AV_CEIL_RSHIFT(frame->height, shift_h);
+    auto const width = AV_CEIL_RSHIFT(dst_width, shift_w);
+    auto const height = AV_CEIL_RSHIFT(dst_height, shift_h);
+
+    if (2 == sample_size) {
+      DecimatePlane<uint16_t>(frame->data[plane], frame->linesize[plane],
+                              src_width, src_height, dst, width, height,
+                              num_comps, factor);
+    } else {
+      DecimatePlane<uint8_t>(frame->data[plane], frame->linesize[plane],
+                             src_width, src_height, dst, width, height,
+                             num_comps, factor);
+    }
+    dst += width * height * num_comps * sample_size;
+  }
+
+  return true;
+}
+
+/* Saves decoded frames as planes back to back, pitch is dropped;
+ * All supported formats go through here, so layout of output Buffer is
+ * same as libavutil gives for 1 byte alignment;
+ */
+struct FramePacker {
+  Buffer *own_frame = nullptr;
+  Buffer *frame_view = nullptr;
+
+  // Format and size of last saved frame;
+  Pixel_Format format = UNDEFINED;
+  uint32_t width = 0U;
+  uint32_t height = 0U;
+
+  // Reported once, not on every frame;
+  int unsupported_format = AV_PIX_FMT_NONE;
+
+  /* Frames are scaled down by this factor while copied, for downscaling
+   * which decoder can't do itself;
+   */
+  int decimation = 1;
+
+  /* Returns Buffer with frame or nullptr if format isn't supported;
+   * Destination is used if given and its size matches. Otherwise decoded
+   * picture is given away as it is if its planes are packed already, see
+   * CanPack() for when it happens. Such Buffer is valid as long as frame is;
+   */
+  Buffer *Pack(AVFrame *frame, Buffer *dst) {
+    auto const av_format = (AVPixelFormat)frame->format;
+    auto const pix_fmt = ToPixelFormat(av_format);
+    if (UNDEFINED == pix_fmt) {
+      if (frame->format != unsupported_format) {
+        unsupported_format = frame->format;
+        cerr << "Unsupported pixel format " << av_get_pix_fmt_name(av_format)
+             << endl;
+      }
+      return nullptr;
+    }
+
+    auto const out_width = max(1, frame->width / decimation);
+    auto const out_height = max(1, frame->height / decimation);
+    auto const res =
+        av_image_get_buffer_size(av_format, out_width, out_height, 1);
+    if (res < 0) {
+      return nullptr;
+    }
+    size_t size = res;
+
+    format = pix_fmt;
+    width = out_width;
+    height = out_height;
+
+    if (1 == decimation && !dst && IsPacked(frame, size)) {
+      if (!frame_view) {
+        frame_view = Buffer::Make(size, frame->data[0]);
+      } else {
+        frame_view->Update(size, frame->data[0]);
+      }
+      return frame_view;
+    }
+
+    auto out = dst;
+    if (!out || size != out->GetRawMemSize()) {
+      if (!own_frame) {
+        own_frame = Buffer::MakeOwnMem(size);
+      } else if (size != own_frame->GetRawMemSize()) {
+        delete own_frame;
+        own_frame = Buffer::MakeOwnMem(size);
+      }
+      out = own_frame;
+    }
+
+    if (decimation > 1) {
+      return DecimateToBuffer(frame, out->GetDataAs<uint8_t>(), out_width,
+                              out_height, decimation)
+                 ? out
+                 : nullptr;
+    }
+
+    // Copy pixels, pitch is dropped in the same pass;
+    auto const copied = av_image_copy_to_buffer(
+        out->GetDataAs<uint8_t>(), size, frame->data, frame->linesize,
+        av_format, frame->width, frame->height, 1);
+    return copied < 0 ? nullptr : out;
+  }
+
+  ~FramePacker() {
+    delete own_frame;
+    delete frame_view;
+  }
+};
+
 namespace VPF {
 
 enum DECODE_STATUS { DEC_SUCCESS, DEC_ERROR, DEC_MORE, DEC_EOS };
@@ -58,18 +610,79 @@ struct FfmpegDecodeFrame_Impl {
   AVCodec *p_codec = nullptr;
   AVPacket pkt = {0};
 
-  Buffer *dec_frame = nullptr;
   map<AVFrameSideDataType, Buffer *> side_data;
 
+  /* Caller-provided destination for next frame. Own buffer is used if it's
+   * not given or its size doesn't match;
+   */
+  Buffer *dst_frame = nullptr;
+  Buffer *out_frame = nullptr;
+
+  FrameBufferPool frame_pool;
+  FramePacker packer;
+
   int video_stream_idx = -1;
   bool end_encode = false;
 
+  // Last decoded frame description and Buffer which wraps it;
+  FrameMetadata frame_metadata = {AV_NOPTS_VALUE, AV_NOPTS_VALUE,
+                                  AV_NOPTS_VALUE};
+  Buffer *metadata = nullptr;
+
+  // Keyframe seek timestamps, they're collected upon first sampling;
+  vector<int64_t> keyframes;
+  bool has_keyframes = false;
+
+  // Frames sampled last, packed back to back;
+  vector<uint8_t> samples;
+  Buffer *samples_buffer = nullptr;
+
+  InterruptHandler interrupt_handler;
+  double read_timeout = 0.0;
+
   FfmpegDecodeFrame_Impl(const char *URL, AVDictionary *pOptions) {
 
     av_register_all();
 
+    auto const open_timeout = TakeTimeout(&pOptions, "open_timeout");
+    read_timeout = TakeTimeout(&pOptions, "read_timeout");
+    auto const threading = TakeThreadingSettings(&pOptions);
+
+    // Decode-time downscaling, 1, 2, 4 or 8 times;
+    auto downscale = 1;
+    string value;
+    if (TakeOption(&pOptions, "downscale", value)) {
+      downscale = atoi(value.c_str());
+      if (1 != downscale && 2 != downscale && 4 != downscale &&
+          8 != downscale) {
+        stringstream ss;
+        ss << "Invalid downscale factor " << value << endl;
+        throw invalid_argument(ss.str());
+      }
+    }
+
+    map<string, string> skip_options;
+    for (auto key : skipOptions) {
+      if (TakeOption(&pOptions, key, value)) {
+        skip_options[key] = value;
+      }
+    }
+
+    fmt_ctx = avformat_alloc_context();
+    if (!fmt_ctx) {
+      stringstream ss;
+      ss << "Could not allocate AVFormatContext" << endl;
+      throw runtime_error(ss.str());
+    }
+    interrupt_handler.Install(fmt_ctx);
+    interrupt_handler.Arm(open_timeout);
+
     auto res = avformat_open_input(&fmt_ctx, URL, NULL, &pOptions);
-    if (res < 0) {
+    if (res < 0 && interrupt_handler.IsTimedOut()) {
+      stringstream ss;
+      ss << "Opening source file " << URL << " timed out" << endl;
+      throw TimeoutException(ss.str());
+    } else if (res < 0) {
       stringstream ss;
       ss << "Could not open source file" << URL << endl;
       ss << "Error description: " << AvErrorToString(res) << endl;
@@ -77,13 +690,19 @@ struct FfmpegDecodeFrame_Impl {
     }
 
     res = avformat_find_stream_info(fmt_ctx, NULL);
-    if (res < 0) {
+    if (res < 0 && interrupt_handler.IsTimedOut()) {
+      stringstream ss;
+      ss << "Stream information lookup timed out" << endl;
+      throw TimeoutException(ss.str());
+    } else if (res < 0) {
       stringstream ss;
       ss << "Could not find stream information" << endl;
       ss << "Error description: " << AvErrorToString(res) << endl;
       throw runtime_error(ss.str());
     }
 
+    interrupt_handler.Disarm();
+
     res = av_find_best_stream(fmt_ctx, AVMEDIA_TYPE_VIDEO, -1, -1, NULL, 0);
     if (res < 0) {
       stringstream ss;
@@ -97,24 +716,62 @@ struct FfmpegDecodeFrame_Impl {
     video_stream = fmt_ctx->streams[video_stream_idx];
 
     if (!video_stream) {
-      cerr << "Could not find video stream in the input, aborting" << endl;
+      stringstream ss;
+      ss << "Could not find video stream in the input, aborting" << endl;
+      throw runtime_error(ss.str());
     }
 
-    avctx = fmt_ctx->streams[video_stream_idx]->codec;
+    p_codec = avcodec_find_decoder(video_stream->codecpar->codec_id);
+    if (!p_codec) {
+      stringstream ss;
+      ss << "Failed to find codec for video stream" << endl;
+      throw runtime_error(ss.str());
+    }
+
+    avctx = avcodec_alloc_context3(p_codec);
     if (!avctx) {
       stringstream ss;
-      ss << "Failed to use codec context from AVFormatContext" << endl;
+      ss << "Could not allocate AVCodecContext" << endl;
       throw runtime_error(ss.str());
     }
 
-    p_codec = avcodec_find_decoder(avctx->codec_id);
-    if (!p_codec) {
+    res = avcodec_parameters_to_context(avctx, video_stream->codecpar);
+    if (res < 0) {
       stringstream ss;
-      ss << "Failed to find codec from AVCodecContext" << endl;
+      ss << "Failed to copy codec parameters to AVCodecContext" << endl;
+      ss << "Error description: " << AvErrorToString(res) << endl;
       throw runtime_error(ss.str());
     }
+    avctx->pkt_timebase = video_stream->time_base;
 
-    res = avcodec_open2(avctx, p_codec, &pOptions);
+    avctx->opaque = &frame_pool;
+    avctx->get_buffer2 = &GetFrameBuffer;
+#if LIBAVCODEC_VERSION_MAJOR < 59
+    avctx->thread_safe_callbacks = 1;
+#endif
+
+    if (threading.threadCount >= 0) {
+      avctx->thread_count = threading.threadCount;
+    }
+
+    if (threading.threadType >= 0) {
+      avctx->thread_type = threading.threadType;
+    }
+
+    SetSkipOptions(skip_options);
+
+    /* Codec native lowres decoding does as much of downscaling as it can,
+     * frames are decimated while copied for the rest;
+     */
+    auto lowres = 0;
+    while ((1 << (lowres + 1)) <= downscale &&
+           lowres < p_codec->max_lowres) {
+      lowres++;
+    }
+    avctx->lowres = lowres;
+    packer.decimation = downscale >> lowres;
+
+    res = OpenCodec(avctx, p_codec, &pOptions, threading.affinity);
     if (res < 0) {
       stringstream ss;
       ss << "Failed to open codec "
@@ -129,36 +786,11 @@ struct FfmpegDecodeFrame_Impl {
     if (!frame) {
       cerr << "Could not allocate frame" << endl;
     }
-  }
-
-  bool SaveYUV420(AVFrame *pframe) {
-    // Detect frame size & allocate memory if necessary;
-    size_t size = frame->width * frame->height * 3 / 2;
-
-    if (!dec_frame) {
-      dec_frame = Buffer::MakeOwnMem(size);
-    } else if (size != dec_frame->GetRawMemSize()) {
-      delete dec_frame;
-      dec_frame = Buffer::MakeOwnMem(size);
-    }
-
-    // Copy pixels;
-    auto plane = 0U;
-    auto *dst = dec_frame->GetDataAs<uint8_t>();
 
-    for (plane = 0; plane < 3; plane++) {
-      auto *src = frame->data[plane];
-      auto width = (0 == plane) ? frame->width : frame->width / 2;
-      auto height = (0 == plane) ? frame->height : frame->height / 2;
+    metadata = Buffer::Make(sizeof(frame_metadata), &frame_metadata);
 
-      for (int i = 0; i < height; i++) {
-        memcpy(dst, src, width);
-        dst += width;
-        src += frame->linesize[plane];
-      }
-    }
-
-    return true;
+    // Options which weren't consumed by libavformat and libavcodec;
+    av_dict_free(&pOptions);
   }
 
   bool DecodeSingleFrame() {
@@ -171,7 +803,16 @@ struct FfmpegDecodeFrame_Impl {
       // Read packets from stream until we find a video packet;
       do {
         auto ret = av_read_frame(fmt_ctx, &pkt);
-        if (ret < 0) {
+        if (AVERROR_EXIT == ret) {
+          /* Read was interrupted, it's not the end of stream;
+           * Clear AVIO context error state so that caller may retry;
+           */
+          if (fmt_ctx->pb) {
+            fmt_ctx->pb->eof_reached = 0;
+            fmt_ctx->pb->error = 0;
+          }
+          return false;
+        } else if (ret < 0) {
           // Flush decoder;
           end_encode = true;
           return DecodeSinglePacket(nullptr);
@@ -195,13 +836,19 @@ struct FfmpegDecodeFrame_Impl {
     return true;
   }
 
-  bool SaveVideoFrame(AVFrame *frame) {
-    // Only YUV420P is supported so far;
-    if (AV_PIX_FMT_YUV420P != frame->format) {
-      return false;
+  void SetSkipOptions(const map<string, string> &options) {
+    for (auto &option : options) {
+      if (!SetSkipOption(avctx, option.first, option.second)) {
+        stringstream ss;
+        ss << "Unknown decoder option " << option.first << endl;
+        throw invalid_argument(ss.str());
+      }
     }
+  }
 
-    return SaveYUV420(frame);
+  bool SaveVideoFrame(AVFrame *frame) {
+    out_frame = packer.Pack(frame, dst_frame);
+    return nullptr != out_frame;
   }
 
   void SaveMotionVectors(AVFrame *frame) {
@@ -222,6 +869,23 @@ struct FfmpegDecodeFrame_Impl {
     }
   }
 
+  void SaveMetadata(AVFrame *frame) {
+    auto &md = frame_metadata;
+    md.pts = frame->pts;
+    md.pkt_dts = frame->pkt_dts;
+    md.best_effort_timestamp = frame->best_effort_timestamp;
+    md.duration = frame->pkt_duration;
+    md.time_base_num = video_stream->time_base.num;
+    md.time_base_den = video_stream->time_base.den;
+    md.width = frame->width;
+    md.height = frame->height;
+    md.pict_type = frame->pict_type;
+    md.repeat_pict = frame->repeat_pict;
+    md.key_frame = frame->key_frame;
+    md.interlaced_frame = frame->interlaced_frame;
+    md.top_field_first = frame->top_field_first;
+  }
+
   bool SaveSideData(AVFrame *frame) {
     SaveMotionVectors(frame);
     return true;
@@ -248,7 +912,9 @@ struct FfmpegDecodeFrame_Impl {
         return DEC_ERROR;
       }
 
+      out_frame = nullptr;
       SaveVideoFrame(frame);
+      SaveMetadata(frame);
       SaveSideData(frame);
       return DEC_SUCCESS;
     }
@@ -256,9 +922,309 @@ struct FfmpegDecodeFrame_Impl {
     return DEC_SUCCESS;
   }
 
+  // Timestamp which keyframes are sought by, dts unless it's unknown;
+  static int64_t SeekTimestamp(const AVPacket &packet) {
+    return AV_NOPTS_VALUE != packet.dts ? packet.dts : packet.pts;
+  }
+
+  /* Collects seek timestamps of all video keyframes;
+   * Container index is used if there's one, otherwise whole input is read
+   * through once. Decoder is positioned at the beginning afterwards;
+   */
+  vector<int64_t> GetKeyframeTimestamps() {
+    vector<int64_t> timestamps;
+
+#if LIBAVFORMAT_VERSION_INT >= AV_VERSION_INT(58, 78, 100)
+    auto const num_entries = avformat_index_get_entries_count(video_stream);
+#else
+    auto const num_entries = video_stream->nb_index_entries;
+#endif
+    for (auto i = 0; i < num_entries; i++) {
+#if LIBAVFORMAT_VERSION_INT >= AV_VERSION_INT(58, 78, 100)
+      auto entry = avformat_index_get_entry(video_stream, i);
+#else
+      auto entry = video_stream->index_entries + i;
+#endif
+      if (entry->flags & AVINDEX_KEYFRAME) {
+        timestamps.push_back(entry->timestamp);
+      }
+    }
+
+    if (timestamps.empty()) {
+      while (av_read_frame(fmt_ctx, &pkt) >= 0) {
+        if (pkt.stream_index == video_stream_idx &&
+            (pkt.flags & AV_PKT_FLAG_KEY) &&
+            AV_NOPTS_VALUE != SeekTimestamp(pkt)) {
+          timestamps.push_back(SeekTimestamp(pkt));
+        }
+        av_packet_unref(&pkt);
+      }
+    }
+
+    if (!timestamps.empty()) {
+      av_seek_frame(fmt_ctx, video_stream_idx, timestamps.front(),
+                    AVSEEK_FLAG_BACKWARD);
+    }
+    avcodec_flush_buffers(avctx);
+    end_encode = false;
+
+    return timestamps;
+  }
+
+  /* Decodes GOP range which starts at keyframe with start_ts seek timestamp
+   * and ends before keyframe with end_ts one (which is AV_NOPTS_VALUE for
+   * the last range). Frames are given to callback in display order as soon
+   * as they are decoded, it takes ownership of them;
+   * Leading pictures of the next range's first GOP refer to this range, so
+   * decoding goes on past its end until they're done. Own leading pictures
+   * are dropped, as they are returned by previous range;
+   * Every read is bounded by read_timeout. Returns false if range can't be
+   * read till the end, e. g. after interrupt or timeout, or if callback
+   * returns false;
+   */
+  bool DecodeRange(int64_t start_ts, int64_t end_ts, bool is_first,
+                   const function<bool(AVFrame *)> &on_frame) {
+    interrupt_handler.Arm(read_timeout);
+    auto res = av_seek_frame(fmt_ctx, video_stream_idx, start_ts,
+                             AVSEEK_FLAG_BACKWARD);
+    if (res < 0) {
+      interrupt_handler.Disarm();
+      ClearReadError();
+      cerr << "Can't seek to " << start_ts << ": " << AvErrorToString(res)
+           << endl;
+      return false;
+    }
+    avcodec_flush_buffers(avctx);
+
+    auto start_pts = numeric_limits<int64_t>::min();
+    auto end_pts = numeric_limits<int64_t>::max();
+    bool is_started = false, is_past_end = false, is_aborted = false;
+
+    auto receive = [&]() {
+      while (!is_aborted && avcodec_receive_frame(avctx, frame) >= 0) {
+        auto const pts = frame->best_effort_timestamp;
+        if (AV_NOPTS_VALUE != pts && (pts < start_pts || pts >= end_pts)) {
+          av_frame_unref(frame);
+          continue;
+        }
+
+        auto out = av_frame_alloc();
+        if (!out) {
+          av_frame_unref(frame);
+          continue;
+        }
+        av_frame_move_ref(out, frame);
+        is_aborted = !on_frame(out);
+      }
+    };
+
+    while (!is_aborted) {
+      interrupt_handler.Arm(read_timeout);
+      res = av_read_frame(fmt_ctx, &pkt);
+      if (res < 0) {
+        break;
+      }
+
+      if (pkt.stream_index != video_stream_idx) {
+        av_packet_unref(&pkt);
+        continue;
+      }
+
+      auto const ts = SeekTimestamp(pkt);
+      auto const is_key = (0 != (pkt.flags & AV_PKT_FLAG_KEY));
+
+      // Seek may land at earlier keyframe;
+      if (!is_started) {
+        if (!is_key || (AV_NOPTS_VALUE != ts && ts < start_ts)) {
+          av_packet_unref(&pkt);
+          continue;
+        }
+        is_started = true;
+        if (!is_first && AV_NOPTS_VALUE != pkt.pts) {
+          start_pts = pkt.pts;
+        }
+      }
+
+      if (AV_NOPTS_VALUE != end_ts && !is_past_end && is_key &&
+          AV_NOPTS_VALUE != ts && ts >= end_ts) {
+        is_past_end = true;
+        if (AV_NOPTS_VALUE != pkt.pts) {
+          end_pts = pkt.pts;
+        }
+      } else if (is_past_end &&
+                 (AV_NOPTS_VALUE == ts || ts >= end_pts)) {
+        // Leading pictures are decoded before display time they precede;
+        av_packet_unref(&pkt);
+        break;
+      }
+
+      res = avcodec_send_packet(avctx, &pkt);
+      av_packet_unref(&pkt);
+      if (res < 0 && AVERROR(EAGAIN) != res) {
+        cerr << "Error while sending a packet to the decoder: "
+             << AvErrorToString(res) << endl;
+      }
+      receive();
+    }
+    interrupt_handler.Disarm();
+
+    if (is_aborted) {
+      return false;
+    }
+
+    if (res < 0 && AVERROR_EOF != res) {
+      cerr << "Can't read range at " << start_ts << ": "
+           << AvErrorToString(res) << endl;
+      ClearReadError();
+      return false;
+    }
+
+    avcodec_send_packet(avctx, nullptr);
+    receive();
+    return !is_aborted;
+  }
+
+  // Interrupted read leaves AVIO context in error state, so it's cleared;
+  void ClearReadError() {
+    if (fmt_ctx->pb) {
+      fmt_ctx->pb->eof_reached = 0;
+      fmt_ctx->pb->error = 0;
+    }
+  }
+
+  /* Returns next frame in display order or nullptr at the end of input;
+   * read_ts is updated with seek timestamp of every video packet read;
+   */
+  AVFrame *DecodeNextFrame(int64_t &read_ts) {
+    while (true) {
+      auto res = avcodec_receive_frame(avctx, frame);
+      if (res >= 0) {
+        auto out = av_frame_alloc();
+        if (out) {
+          av_frame_move_ref(out, frame);
+          return out;
+        }
+        av_frame_unref(frame);
+        continue;
+      } else if (AVERROR(EAGAIN) != res) {
+        return nullptr;
+      }
+
+      do {
+        res = av_read_frame(fmt_ctx, &pkt);
+        if (res >= 0 && pkt.stream_index != video_stream_idx) {
+          av_packet_unref(&pkt);
+        }
+      } while (res >= 0 && pkt.stream_index != video_stream_idx);
+
+      if (res < 0) {
+        // Flush decoder;
+        avcodec_send_packet(avctx, nullptr);
+        continue;
+      }
+
+      if (AV_NOPTS_VALUE != SeekTimestamp(pkt)) {
+        read_ts = SeekTimestamp(pkt);
+      }
+      res = avcodec_send_packet(avctx, &pkt);
+      av_packet_unref(&pkt);
+      if (res < 0 && AVERROR(EAGAIN) != res) {
+        cerr << "Error while sending a packet to the decoder: "
+             << AvErrorToString(res) << endl;
+      }
+    }
+  }
+
+  /* Decodes frames shown at given timestamps, in stream time base. Frame
+   * shown at timestamp is the last one with pts not past it;
+   * Targets are visited in ascending order. Decoder seeks only if target
+   * lies in GOP which is ahead of packets read so far, otherwise it decodes
+   * forward and drops frames which aren't needed. frames[i] corresponds to
+   * timestamps[i], it's nullptr if nothing was decoded for it;
+   * Sequential decoding goes on from where sampling has stopped;
+   */
+  bool SampleFrames(const vector<int64_t> &timestamps,
+                    vector<AVFrame *> &frames) {
+    if (!has_keyframes) {
+      keyframes = GetKeyframeTimestamps();
+      has_keyframes = true;
+    }
+
+    vector<size_t> order(timestamps.size());
+    for (size_t i = 0U; i < order.size(); i++) {
+      order[i] = i;
+    }
+    stable_sort(order.begin(), order.end(), [&](size_t lhs, size_t rhs) {
+      return timestamps[lhs] < timestamps[rhs];
+    });
+    frames.assign(timestamps.size(), nullptr);
+
+    // Last frame not past current target and the first one past it;
+    AVFrame *prev = nullptr, *next = nullptr;
+    auto read_ts = AV_NOPTS_VALUE;
+    bool is_eof = false;
+
+    for (auto idx : order) {
+      auto const target = timestamps[idx];
+
+      // Keyframe of GOP which target belongs to;
+      if (!keyframes.empty()) {
+        auto it = upper_bound(keyframes.begin(), keyframes.end(), target);
+        auto const key_ts = (keyframes.begin() == it) ? *it : *(--it);
+
+        if (AV_NOPTS_VALUE == read_ts || key_ts > read_ts) {
+          auto res = av_seek_frame(fmt_ctx, video_stream_idx, key_ts,
+                                   AVSEEK_FLAG_BACKWARD);
+          if (res < 0) {
+            cerr << "Can't seek to " << key_ts << ": " << AvErrorToString(res)
+                 << endl;
+          } else {
+            avcodec_flush_buffers(avctx);
+            av_frame_free(&prev);
+            av_frame_free(&next);
+            read_ts = key_ts;
+            is_eof = false;
+          }
+        }
+      }
+
+      // Decode forward until frame past target shows up;
+      while (true) {
+        if (next && AV_NOPTS_VALUE != next->best_effort_timestamp &&
+            next->best_effort_timestamp <= target) {
+          av_frame_free(&prev);
+          swap(prev, next);
+        }
+
+        if (next || is_eof) {
+          break;
+        }
+
+        next = DecodeNextFrame(read_ts);
+        is_eof = !next;
+      }
+
+      // Target which precedes the first frame gets that frame;
+      auto sample = prev ? prev : next;
+      if (sample) {
+        frames[idx] = av_frame_clone(sample);
+      }
+    }
+
+    av_frame_free(&prev);
+    av_frame_free(&next);
+    end_encode = is_eof;
+
+    return true;
+  }
+
   ~FfmpegDecodeFrame_Impl() {
-    avformat_close_input(&fmt_ctx);
+    // Pool is released after decoder and frame drop their buffers;
     av_frame_free(&frame);
+    avcodec_free_context(&avctx);
+    avformat_close_input(&fmt_ctx);
+    delete samples_buffer;
+    delete metadata;
 
     for (auto &output : side_data) {
       if (output.second) {
@@ -266,10 +1232,6 @@ struct FfmpegDecodeFrame_Impl {
         output.second = nullptr;
       }
     }
-
-    if (dec_frame) {
-      delete dec_frame;
-    }
   }
 };
 } // namespace VPF
@@ -277,12 +1239,91 @@ struct FfmpegDecodeFrame_Impl {
 TaskExecStatus FfmpegDecodeFrame::Execute() {
   ClearOutputs();
 
-  if (pImpl->DecodeSingleFrame()) {
-    SetOutput((Token *)pImpl->dec_frame, 0U);
+  pImpl->dst_frame = (Buffer *)GetInput(0U);
+  pImpl->interrupt_handler.Arm(pImpl->read_timeout);
+  auto const res = pImpl->DecodeSingleFrame();
+  pImpl->interrupt_handler.Disarm();
+
+  if (res) {
+    SetOutput((Token *)pImpl->out_frame, 0U);
+    SetOutput((Token *)pImpl->metadata, 2U);
     return TaskExecStatus::TASK_EXEC_SUCCESS;
   }
 
-  return TaskExecStatus::TASK_EXEC_FAIL;
+  return pImpl->interrupt_handler.IsTimedOut()
+             ? TaskExecStatus::TASK_EXEC_TIMEOUT
+             : TaskExecStatus::TASK_EXEC_FAIL;
+}
+
+void FfmpegDecodeFrame::Interrupt() { pImpl->interrupt_handler.Interrupt(); }
+
+Pixel_Format FfmpegDecodeFrame::GetPixelFormat() const {
+  return pImpl->packer.format;
+}
+
+uint32_t FfmpegDecodeFrame::GetWidth() const { return pImpl->packer.width; }
+
+uint32_t FfmpegDecodeFrame::GetHeight() const { return pImpl->packer.height; }
+
+double FfmpegDecodeFrame::GetTimestamp() const {
+  auto const pts = pImpl->frame_metadata.best_effort_timestamp;
+  if (AV_NOPTS_VALUE == pts) {
+    return numeric_limits<double>::quiet_NaN();
+  }
+
+  return pts * av_q2d(pImpl->video_stream->time_base);
+}
+
+void FfmpegDecodeFrame::SetSkipOptions(const map<string, string> &options) {
+  pImpl->SetSkipOptions(options);
+}
+
+TaskExecStatus FfmpegDecodeFrame::SampleFrames(const vector<double> &timestamps,
+                                               vector<size_t> &frame_sizes) {
+  ClearOutputs();
+  frame_sizes.clear();
+
+  auto const time_base = av_q2d(pImpl->video_stream->time_base);
+  vector<int64_t> targets;
+  for (auto timestamp : timestamps) {
+    targets.push_back(llround(timestamp / time_base));
+  }
+
+  vector<AVFrame *> frames;
+  pImpl->interrupt_handler.Arm(pImpl->read_timeout);
+  pImpl->SampleFrames(targets, frames);
+  pImpl->interrupt_handler.Disarm();
+
+  // Frames are packed one after another into single chunk of memory;
+  auto &samples = pImpl->samples;
+  samples.clear();
+  for (auto &frame : frames) {
+    // Packed frame may refer to decoded one, it's released after copy;
+    auto packed = frame ? pImpl->packer.Pack(frame, nullptr) : nullptr;
+    auto const size = packed ? packed->GetRawMemSize() : 0U;
+    auto const offset = samples.size();
+    if (size) {
+      samples.resize(offset + size);
+      memcpy(samples.data() + offset, packed->GetRawMemPtr(), size);
+    }
+    frame_sizes.push_back(size);
+    av_frame_free(&frame);
+  }
+
+  if (samples.empty()) {
+    return pImpl->interrupt_handler.IsTimedOut()
+               ? TaskExecStatus::TASK_EXEC_TIMEOUT
+               : TaskExecStatus::TASK_EXEC_FAIL;
+  }
+
+  if (!pImpl->samples_buffer) {
+    pImpl->samples_buffer = Buffer::Make(samples.size(), samples.data());
+  } else {
+    pImpl->samples_buffer->Update(samples.size(), samples.data());
+  }
+
+  SetOutput((Token *)pImpl->samples_buffer, 0U);
+  return TaskExecStatus::TASK_EXEC_SUCCESS;
 }
 
 TaskExecStatus FfmpegDecodeFrame::GetSideData(AVFrameSideDataType data_type) {
@@ -308,4 +1349,320 @@ FfmpegDecodeFrame::FfmpegDecodeFrame(const char *URL,
   pImpl = new FfmpegDecodeFrame_Impl(URL, cli_iface.GetOptions());
 }
 
-FfmpegDecodeFrame::~FfmpegDecodeFrame() { delete pImpl; }
\ No newline at end of file
+FfmpegDecodeFrame::~FfmpegDecodeFrame() { delete pImpl; }
+namespace VPF {
+// Default budget of frames decoded ahead, in bytes;
+static const size_t default_bytes_ahead = 1024U * 1024U * 1024U;
+
+struct FfmpegParallelDecodeFrame_Impl {
+  // Every decoder has its own input context and worker thread;
+  vector<unique_ptr<FfmpegDecodeFrame_Impl>> decoders;
+  vector<thread> workers;
+
+  // Seek timestamps of first keyframe of every GOP range;
+  vector<int64_t> ranges;
+
+  struct RangeFrames {
+    // Decoded frames which aren't given away yet;
+    deque<AVFrame *> frames;
+    /* Frames taken from decoder so far. Range which timed out is decoded
+     * from start again, so that many frames are skipped then;
+     */
+    size_t num_received = 0U;
+    bool is_done = false;
+    bool is_failed = false;
+    bool is_timed_out = false;
+    bool is_retried = false;
+  };
+
+  // Reorder buffer, ranges which aren't given away yet by range index;
+  map<size_t, RangeFrames> decoded;
+
+  mutex decode_mutex;
+  condition_variable decode_cv;
+  size_t next_range = 0U;
+  size_t out_range = 0U;
+  size_t max_ranges_ahead = 0U;
+
+  /* Frames kept in reorder buffer are bounded, as every one of them holds
+   * pooled frame memory. Range which is given away may go past the bound by
+   * one frame, so that it never waits for ranges which follow;
+   */
+  size_t max_frames_ahead = 0U;
+  size_t num_buffered = 0U;
+  bool stop = false;
+
+  // Frame which was given away last, output Buffer may refer to it;
+  AVFrame *out_frame = nullptr;
+  FramePacker packer;
+
+  FfmpegParallelDecodeFrame_Impl(const char *URL, AVDictionary *pOptions) {
+    auto num_workers = max(1U, thread::hardware_concurrency());
+    auto gops_per_range = 1U;
+
+    string value;
+    try {
+      if (TakeOption(&pOptions, "workers", value)) {
+        num_workers = stoul(value);
+      }
+
+      if (TakeOption(&pOptions, "gops_per_range", value)) {
+        gops_per_range = stoul(value);
+      }
+
+      if (TakeOption(&pOptions, "max_frames_ahead", value)) {
+        max_frames_ahead = stoul(value);
+      }
+    } catch (exception &e) {
+      stringstream ss;
+      ss << "Invalid decoder option value " << value << ": " << e.what()
+         << endl;
+      throw invalid_argument(ss.str());
+    }
+    num_workers = max(1U, num_workers);
+    gops_per_range = max(1U, gops_per_range);
+
+    for (auto i = 0U; i < num_workers; i++) {
+      AVDictionary *options = nullptr;
+      av_dict_copy(&options, pOptions, 0);
+      decoders.emplace_back(new FfmpegDecodeFrame_Impl(URL, options));
+    }
+    av_dict_free(&pOptions);
+
+    // Downscaling which isn't done by decoders is done here;
+    packer.decimation = decoders.front()->packer.decimation;
+
+    auto const keyframes = decoders.front()->GetKeyframeTimestamps();
+    for (auto i = 0U; i < keyframes.size(); i += gops_per_range) {
+      ranges.push_back(keyframes[i]);
+    }
+
+    if (ranges.empty()) {
+      stringstream ss;
+      ss << "Could not find keyframes in " << URL << endl;
+      throw runtime_error(ss.str());
+    }
+
+    // Every worker may take range ahead, one more is given away meanwhile;
+    max_ranges_ahead = num_workers + 1U;
+
+    // Frame size is estimated from codec parameters if bound isn't given;
+    if (!max_frames_ahead) {
+      auto const avctx = decoders.front()->avctx;
+      auto const frame_size = av_image_get_buffer_size(
+          avctx->pix_fmt, avctx->width, avctx->height, 1);
+      max_frames_ahead = max<size_t>(
+          num_workers + 1U, frame_size > 0 ? default_bytes_ahead / frame_size
+                                           : 0U);
+    }
+
+    for (auto &decoder : decoders) {
+      workers.emplace_back(&FfmpegParallelDecodeFrame_Impl::Work, this,
+                           decoder.get());
+    }
+  }
+
+  /* Range which times out is kept by worker and decoded again once caller
+   * retries, so that frames given away aren't repeated;
+   */
+  void Work(FfmpegDecodeFrame_Impl *decoder) {
+    while (true) {
+      size_t range = 0U;
+      {
+        unique_lock<mutex> lock(decode_mutex);
+        decode_cv.wait(lock, [&]() {
+          return stop || next_range >= ranges.size() ||
+                 next_range < out_range + max_ranges_ahead;
+        });
+
+        if (stop || next_range >= ranges.size()) {
+          return;
+        }
+        range = next_range++;
+        decoded[range];
+      }
+
+      auto const end_ts =
+          (range + 1U < ranges.size()) ? ranges[range + 1U] : AV_NOPTS_VALUE;
+
+      while (true) {
+        size_t num_decoded = 0U;
+        auto on_frame = [&](AVFrame *frame) {
+          unique_lock<mutex> lock(decode_mutex);
+          auto &entry = decoded[range];
+          if (num_decoded++ < entry.num_received) {
+            av_frame_free(&frame);
+            return !stop;
+          }
+
+          decode_cv.wait(lock, [&]() {
+            return stop || num_buffered < max_frames_ahead ||
+                   (range == out_range && entry.frames.empty());
+          });
+
+          if (stop) {
+            av_frame_free(&frame);
+            return false;
+          }
+
+          entry.frames.push_back(frame);
+          entry.num_received++;
+          num_buffered++;
+          lock.unlock();
+          decode_cv.notify_all();
+          return true;
+        };
+
+        auto const res = decoder->DecodeRange(ranges[range], end_ts,
+                                              0U == range, on_frame);
+
+        unique_lock<mutex> lock(decode_mutex);
+        auto &entry = decoded[range];
+        if (res || stop || !decoder->interrupt_handler.IsTimedOut()) {
+          entry.is_done = true;
+          entry.is_failed = !res;
+          lock.unlock();
+          decode_cv.notify_all();
+          break;
+        }
+
+        entry.is_timed_out = true;
+        decode_cv.notify_all();
+        decode_cv.wait(lock, [&]() { return stop || entry.is_retried; });
+        if (stop) {
+          return;
+        }
+        entry.is_retried = false;
+      }
+    }
+  }
+
+  /* Gives next frame in display order, nullptr at the end of input;
+   * Frames are given away as soon as they are decoded, without waiting for
+   * range to be done. Range which timed out is decoded again by next call;
+   */
+  TaskExecStatus NextFrame(AVFrame *&next) {
+    next = nullptr;
+
+    unique_lock<mutex> lock(decode_mutex);
+    while (out_range < ranges.size()) {
+      decode_cv.wait(lock, [&]() {
+        auto it = decoded.find(out_range);
+        if (decoded.end() == it) {
+          return stop;
+        }
+        auto &entry = it->second;
+        return stop || !entry.frames.empty() || entry.is_done ||
+               entry.is_timed_out;
+      });
+
+      if (stop) {
+        return TaskExecStatus::TASK_EXEC_FAIL;
+      }
+
+      auto &entry = decoded[out_range];
+      if (!entry.frames.empty()) {
+        next = entry.frames.front();
+        entry.frames.pop_front();
+        num_buffered--;
+        decode_cv.notify_all();
+        return TaskExecStatus::TASK_EXEC_SUCCESS;
+      } else if (entry.is_timed_out) {
+        entry.is_timed_out = false;
+        entry.is_retried = true;
+        decode_cv.notify_all();
+        return TaskExecStatus::TASK_EXEC_TIMEOUT;
+      } else if (entry.is_failed) {
+        return TaskExecStatus::TASK_EXEC_FAIL;
+      }
+
+      // Range is over, let workers take more;
+      decoded.erase(out_range);
+      out_range++;
+      decode_cv.notify_all();
+    }
+
+    return TaskExecStatus::TASK_EXEC_FAIL;
+  }
+
+  // Aborts I/O of all decoders, ranges which aren't decoded yet are dropped;
+  void Interrupt() {
+    for (auto &decoder : decoders) {
+      decoder->interrupt_handler.Interrupt();
+    }
+
+    {
+      lock_guard<mutex> lock(decode_mutex);
+      stop = true;
+    }
+    decode_cv.notify_all();
+  }
+
+  ~FfmpegParallelDecodeFrame_Impl() {
+    {
+      lock_guard<mutex> lock(decode_mutex);
+      stop = true;
+    }
+    decode_cv.notify_all();
+
+    for (auto &worker : workers) {
+      worker.join();
+    }
+
+    for (auto &entry : decoded) {
+      for (auto &frame : entry.second.frames) {
+        av_frame_free(&frame);
+      }
+    }
+    av_frame_free(&out_frame);
+  }
+};
+} // namespace VPF
+
+TaskExecStatus FfmpegParallelDecodeFrame::Execute() {
+  ClearOutputs();
+
+  av_frame_free(&pImpl->out_frame);
+  auto const res = pImpl->NextFrame(pImpl->out_frame);
+  if (TaskExecStatus::TASK_EXEC_SUCCESS != res) {
+    return res;
+  }
+
+  auto out = pImpl->packer.Pack(pImpl->out_frame, (Buffer *)GetInput(0U));
+  if (!out) {
+    return TaskExecStatus::TASK_EXEC_FAIL;
+  }
+
+  SetOutput((Token *)out, 0U);
+  return TaskExecStatus::TASK_EXEC_SUCCESS;
+}
+
+void FfmpegParallelDecodeFrame::Interrupt() { pImpl->Interrupt(); }
+
+Pixel_Format FfmpegParallelDecodeFrame::GetPixelFormat() const {
+  return pImpl->packer.format;
+}
+
+uint32_t FfmpegParallelDecodeFrame::GetWidth() const {
+  return pImpl->packer.width;
+}
+
+uint32_t FfmpegParallelDecodeFrame::GetHeight() const {
+  return pImpl->packer.height;
+}
+
+FfmpegParallelDecodeFrame *
+FfmpegParallelDecodeFrame::Make(const char *URL,
+                                NvDecoderClInterface &cli_iface) {
+  return new FfmpegParallelDecodeFrame(URL, cli_iface);
+}
+
+FfmpegParallelDecodeFrame::FfmpegParallelDecodeFrame(
+    const char *URL, NvDecoderClInterface &cli_iface)
+    : Task("FfmpegParallelDecodeFrame",
+           FfmpegParallelDecodeFrame::num_inputs,
+           FfmpegParallelDecodeFrame::num_outputs) {
+  pImpl = new FfmpegParallelDecodeFrame_Impl(URL, cli_iface.GetOptions());
+}
+
+FfmpegParallelDecodeFrame::~FfmpegParallelDecodeFrame() { delete pImpl; }
@@ -0,0 +1,100 @@
+/*
+ * Copyright 2020 NVIDIA Corporation
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "FileDataProvider.hpp"
+#include <cerrno>
+#include <cstring>
+#include <sstream>
+#include <stdexcept>
+
+#if defined(_WIN32)
+#define fseeko _fseeki64
+#define ftello _ftelli64
+#endif
+
+using namespace std;
+
+FileDataProvider::FileDataProvider(const char *szFilePath) {
+  // "file:" prefix is handled the same way libavformat does;
+  if (0 == strncmp(szFilePath, "file:", 5)) {
+    szFilePath += 5;
+  }
+
+  file = fopen(szFilePath, "rb");
+  if (!file) {
+    stringstream ss;
+    ss << __FUNCTION__ << ": can't open " << szFilePath << ": "
+       << strerror(errno);
+    throw runtime_error(ss.str());
+  }
+
+  // AVIO context does buffering;
+  setvbuf(file, nullptr, _IONBF, 0);
+
+  if (0 != fseeko(file, 0, SEEK_END) || (fileSize = ftello(file)) < 0 ||
+      0 != fseeko(file, 0, SEEK_SET)) {
+    fclose(file);
+    stringstream ss;
+    ss << __FUNCTION__ << ": " << szFilePath << " isn't seekable";
+    throw runtime_error(ss.str());
+  }
+}
+
+FileDataProvider::~FileDataProvider() { fclose(file); }
+
+bool FileDataProvider::IsLocalFile(const char *szFilePath) {
+  if (!szFilePath) {
+    return false;
+  }
+
+  if (0 == strncmp(szFilePath, "file:", 5)) {
+    return true;
+  }
+
+  // Anything with protocol prefix goes through libavformat;
+  return !strstr(szFilePath, "://");
+}
+
+int FileDataProvider::GetData(uint8_t *pBuf, int nBuf) {
+  auto const numBytes = fread(pBuf, 1U, nBuf, file);
+  if (!numBytes) {
+    return ferror(file) ? AVERROR(EIO) : AVERROR_EOF;
+  }
+
+  position += numBytes;
+  return (int)numBytes;
+}
+
+int64_t FileDataProvider::Seek(int64_t offset, int whence) {
+  switch (whence & ~AVSEEK_FORCE) {
+  case AVSEEK_SIZE:
+    return fileSize;
+  case SEEK_SET:
+    break;
+  case SEEK_CUR:
+    offset += position;
+    break;
+  case SEEK_END:
+    offset += fileSize;
+    break;
+  default:
+    return AVERROR(EINVAL);
+  }
+
+  if (offset < 0 || 0 != fseeko(file, offset, SEEK_SET)) {
+    return AVERROR(EINVAL);
+  }
+
+  position = offset;
+  return position;
+}
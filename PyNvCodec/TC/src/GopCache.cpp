@@ -0,0 +1,119 @@
+/*
+ * Copyright 2020 NVIDIA Corporation
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "GopCache.hpp"
+
+using namespace std;
+
+size_t CachedGop::SizeInBytes() const {
+  auto const perPacket = sizeof(PacketData) + 2U * sizeof(size_t);
+  return data.size() + packets.size() * perPacket;
+}
+
+GopCache::GopCache(size_t byteBudget) : budget(byteBudget) {}
+
+GopCache &GopCache::GetShared() {
+  static GopCache shared(0U);
+  return shared;
+}
+
+void GopCache::SetByteBudget(size_t byteBudget) {
+  lock_guard<mutex> lock(cacheMutex);
+  budget = byteBudget;
+  Evict();
+}
+
+size_t GopCache::GetByteBudget() const {
+  lock_guard<mutex> lock(cacheMutex);
+  return budget;
+}
+
+size_t GopCache::GetSize() const {
+  lock_guard<mutex> lock(cacheMutex);
+  return size;
+}
+
+void GopCache::Insert(const string &source, int64_t keyPts,
+                      shared_ptr<const CachedGop> gop) {
+  if (!gop || gop->packets.empty()) {
+    return;
+  }
+
+  lock_guard<mutex> lock(cacheMutex);
+  auto const gopSize = gop->SizeInBytes();
+  if (gopSize > budget) {
+    return;
+  }
+
+  auto &gops = entries[source];
+  auto it = gops.find(keyPts);
+  if (gops.end() != it) {
+    // Same GOP was demuxed again, e. g. by another demuxer;
+    size -= it->second.gop->SizeInBytes();
+    lru.erase(it->second.lruPos);
+    gops.erase(it);
+  }
+
+  lru.emplace_front(source, keyPts);
+  gops[keyPts] = {gop, lru.begin()};
+  size += gopSize;
+
+  Evict();
+}
+
+shared_ptr<const CachedGop> GopCache::Find(const string &source, int64_t pts) {
+  lock_guard<mutex> lock(cacheMutex);
+  auto sit = entries.find(source);
+  if (entries.end() == sit) {
+    return nullptr;
+  }
+
+  // Greatest keyframe pts which isn't past given one;
+  auto &gops = sit->second;
+  auto it = gops.upper_bound(pts);
+  if (gops.begin() == it) {
+    return nullptr;
+  }
+  --it;
+
+  auto &entry = it->second;
+  if (!entry.gop->isLast && pts >= entry.gop->endPts) {
+    return nullptr;
+  }
+
+  lru.splice(lru.begin(), lru, entry.lruPos);
+  return entry.gop;
+}
+
+void GopCache::Clear() {
+  lock_guard<mutex> lock(cacheMutex);
+  lru.clear();
+  entries.clear();
+  size = 0U;
+}
+
+void GopCache::Evict() {
+  while (size > budget && !lru.empty()) {
+    auto &key = lru.back();
+    auto sit = entries.find(key.first);
+    auto it = sit->second.find(key.second);
+
+    // GOP stays alive while it's being replayed by any demuxer;
+    size -= it->second.gop->SizeInBytes();
+    sit->second.erase(it);
+    if (sit->second.empty()) {
+      entries.erase(sit);
+    }
+    lru.pop_back();
+  }
+}
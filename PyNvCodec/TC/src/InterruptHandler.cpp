@@ -0,0 +1,56 @@
+/*
+ * Copyright 2020 NVIDIA Corporation
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "InterruptHandler.hpp"
+
+using namespace VPF;
+using namespace std;
+using namespace chrono;
+
+void InterruptHandler::Install(AVFormatContext *ctx) {
+  if (ctx) {
+    ctx->interrupt_callback.callback = &InterruptHandler::Callback;
+    ctx->interrupt_callback.opaque = this;
+  }
+}
+
+void InterruptHandler::Arm(double timeout) {
+  timedOut = false;
+  isArmed = timeout > 0.0;
+  if (isArmed) {
+    deadline = steady_clock::now() +
+               duration_cast<steady_clock::duration>(duration<double>(timeout));
+  }
+}
+
+void InterruptHandler::Disarm() { isArmed = false; }
+
+void InterruptHandler::Interrupt() { interrupted.store(true); }
+
+int InterruptHandler::Callback(void *opaque) {
+  auto pThis = (InterruptHandler *)opaque;
+  if (!pThis) {
+    return 0;
+  }
+
+  if (pThis->IsInterrupted()) {
+    return 1;
+  }
+
+  if (pThis->isArmed && steady_clock::now() > pThis->deadline) {
+    pThis->timedOut = true;
+    return 1;
+  }
+
+  return 0;
+}
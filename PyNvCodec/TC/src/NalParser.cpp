@@ -0,0 +1,708 @@
+/*
+ * Copyright 2020 NVIDIA Corporation
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "NalParser.hpp"
+#include <algorithm>
+
+#if defined(__SSE2__) && (defined(__GNUC__) || defined(__clang__))
+#define VPF_SSE2_START_CODE_SCAN
+#include <emmintrin.h>
+#endif
+
+using namespace VPF;
+using namespace std;
+
+BitReader::BitReader(const uint8_t *data, size_t size)
+    : pData(data), sizeInBits(size * 8U) {}
+
+uint32_t BitReader::ReadBits(uint32_t numBits) {
+  uint32_t value = 0U;
+  for (auto i = 0U; i < numBits; i++) {
+    value <<= 1;
+    if (bitPos < sizeInBits) {
+      value |= (pData[bitPos >> 3] >> (7U - (bitPos & 7U))) & 1U;
+      bitPos++;
+    } else {
+      overrun = true;
+    }
+  }
+  return value;
+}
+
+void BitReader::SkipBits(size_t numBits) {
+  bitPos += numBits;
+  if (bitPos > sizeInBits) {
+    bitPos = sizeInBits;
+    overrun = true;
+  }
+}
+
+uint32_t BitReader::ReadUE() {
+  auto leadingZeros = 0U;
+  while (!ReadBit()) {
+    if (overrun || ++leadingZeros > 31U) {
+      overrun = true;
+      return 0U;
+    }
+  }
+
+  if (!leadingZeros) {
+    return 0U;
+  }
+
+  return (1U << leadingZeros) - 1U + ReadBits(leadingZeros);
+}
+
+int32_t BitReader::ReadSE() {
+  auto codeNum = ReadUE();
+  return (codeNum & 1U) ? (int32_t)((codeNum + 1U) >> 1)
+                        : -(int32_t)(codeNum >> 1);
+}
+
+void VPF::NalToRbsp(const uint8_t *nal, size_t size, vector<uint8_t> &rbsp) {
+  rbsp.clear();
+  rbsp.reserve(size);
+
+  auto numZeroes = 0U;
+  for (size_t i = 0U; i < size; i++) {
+    // Skip 0x03 which follows two zero bytes;
+    if (numZeroes >= 2U && 0x03 == nal[i]) {
+      numZeroes = 0U;
+      continue;
+    }
+
+    numZeroes = nal[i] ? 0U : numZeroes + 1U;
+    rbsp.push_back(nal[i]);
+  }
+}
+
+static uint32_t ReadBE16(const uint8_t *p) { return (p[0] << 8) | p[1]; }
+
+const uint8_t *VPF::FindStartCode(const uint8_t *p, const uint8_t *end) {
+#ifdef VPF_SSE2_START_CODE_SCAN
+  // Check zero bytes only, 2 extra bytes are needed to check them;
+  const __m128i zero = _mm_setzero_si128();
+  while (p + 18 <= end) {
+    auto block = _mm_loadu_si128((const __m128i *)p);
+    auto mask = (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(block, zero));
+    while (mask) {
+      auto i = __builtin_ctz(mask);
+      if (!p[i + 1] && 1 == p[i + 2]) {
+        return p + i;
+      }
+      mask &= mask - 1U;
+    }
+    p += 16;
+  }
+#endif
+
+  while (p + 2 < end) {
+    if (p[2] > 1) {
+      p += 3;
+    } else if (p[1]) {
+      p += 2;
+    } else if (p[0] || 1 != p[2]) {
+      p++;
+    } else {
+      return p;
+    }
+  }
+  return end;
+}
+
+static void AddParameterSet(const uint8_t *nal, size_t size, bool isHEVC,
+                            ParameterSets &paramSets) {
+  if (!size) {
+    return;
+  }
+
+  vector<uint8_t> entry(nal, nal + size);
+  if (isHEVC) {
+    switch ((nal[0] >> 1) & 0x3f) {
+    case 32:
+      paramSets.vps.push_back(entry);
+      break;
+    case 33:
+      paramSets.sps.push_back(entry);
+      break;
+    case 34:
+      paramSets.pps.push_back(entry);
+      break;
+    default:
+      break;
+    }
+  } else {
+    switch (nal[0] & 0x1f) {
+    case 7:
+      paramSets.sps.push_back(entry);
+      break;
+    case 8:
+      paramSets.pps.push_back(entry);
+      break;
+    default:
+      break;
+    }
+  }
+}
+
+static bool ParseAnnexBExtradata(const uint8_t *data, size_t size, bool isHEVC,
+                                 ParameterSets &paramSets) {
+  const uint8_t *end = data + size;
+  const uint8_t *nal = FindStartCode(data, end);
+
+  while (nal < end) {
+    nal += 3;
+    auto next = FindStartCode(nal, end);
+
+    // Trailing zero bytes belong to next start code;
+    auto nalEnd = next;
+    while (nalEnd > nal && !nalEnd[-1]) {
+      nalEnd--;
+    }
+
+    AddParameterSet(nal, nalEnd - nal, isHEVC, paramSets);
+    nal = next;
+  }
+
+  paramSets.nalLengthSize = 0U;
+  return !paramSets.sps.empty();
+}
+
+static bool ParseAvcC(const uint8_t *data, size_t size,
+                      ParameterSets &paramSets) {
+  if (size < 7U) {
+    return false;
+  }
+
+  paramSets.nalLengthSize = (data[4] & 0x03) + 1U;
+  const uint8_t *p = data + 5;
+  const uint8_t *end = data + size;
+
+  // SPS come first, PPS follow;
+  for (auto i = 0; i < 2; i++) {
+    if (p >= end) {
+      return false;
+    }
+    uint32_t numEntries = i ? *p : (*p & 0x1f);
+    p++;
+
+    for (auto j = 0U; j < numEntries; j++) {
+      if (p + 2 > end) {
+        return false;
+      }
+      auto nalSize = ReadBE16(p);
+      p += 2;
+      if (p + nalSize > end) {
+        return false;
+      }
+      AddParameterSet(p, nalSize, false, paramSets);
+      p += nalSize;
+    }
+  }
+
+  return !paramSets.sps.empty();
+}
+
+static bool ParseHvcC(const uint8_t *data, size_t size,
+                      ParameterSets &paramSets) {
+  if (size < 23U) {
+    return false;
+  }
+
+  paramSets.nalLengthSize = (data[21] & 0x03) + 1U;
+  auto numArrays = data[22];
+  const uint8_t *p = data + 23;
+  const uint8_t *end = data + size;
+
+  for (auto i = 0U; i < numArrays; i++) {
+    if (p + 3 > end) {
+      return false;
+    }
+    // Skip array_completeness & NAL unit type, it's in NAL header anyway;
+    p++;
+    auto numNalus = ReadBE16(p);
+    p += 2;
+
+    for (auto j = 0U; j < numNalus; j++) {
+      if (p + 2 > end) {
+        return false;
+      }
+      auto nalSize = ReadBE16(p);
+      p += 2;
+      if (p + nalSize > end) {
+        return false;
+      }
+      AddParameterSet(p, nalSize, true, paramSets);
+      p += nalSize;
+    }
+  }
+
+  return !paramSets.sps.empty();
+}
+
+bool VPF::ParseExtradata(const uint8_t *data, size_t size, bool isHEVC,
+                         ParameterSets &paramSets) {
+  paramSets = ParameterSets();
+  if (!data || size < 4U) {
+    return false;
+  }
+
+  // Same heuristics as libavcodec uses to tell avcC / hvcC from Annex.B;
+  if (isHEVC) {
+    if (data[0] || data[1] || data[2] > 1) {
+      return ParseHvcC(data, size, paramSets);
+    }
+  } else if (1 == data[0]) {
+    return ParseAvcC(data, size, paramSets);
+  }
+
+  return ParseAnnexBExtradata(data, size, isHEVC, paramSets);
+}
+
+static void SkipH264ScalingList(BitReader &br, uint32_t listSize) {
+  int32_t lastScale = 8, nextScale = 8;
+  for (auto j = 0U; j < listSize; j++) {
+    if (nextScale) {
+      nextScale = (lastScale + br.ReadSE() + 256) % 256;
+    }
+    lastScale = nextScale ? nextScale : lastScale;
+  }
+}
+
+bool VPF::ParseH264Sps(const uint8_t *nal, size_t size, SpsInfo &info) {
+  if (size < 4U || 7 != (nal[0] & 0x1f)) {
+    return false;
+  }
+
+  vector<uint8_t> rbsp;
+  NalToRbsp(nal + 1, size - 1, rbsp);
+  BitReader br(rbsp.data(), rbsp.size());
+
+  auto profileIdc = br.ReadBits(8);
+  // Constraint flags & level_idc;
+  br.SkipBits(16);
+  br.ReadUE();
+
+  info.chromaFormatIdc = 1U;
+  info.bitDepthLuma = 8U;
+  auto separateColourPlane = 0U;
+
+  switch (profileIdc) {
+  case 100:
+  case 110:
+  case 122:
+  case 244:
+  case 44:
+  case 83:
+  case 86:
+  case 118:
+  case 128:
+  case 138:
+  case 139:
+  case 134:
+  case 135:
+    info.chromaFormatIdc = br.ReadUE();
+    if (3 == info.chromaFormatIdc) {
+      separateColourPlane = br.ReadBit();
+    }
+    info.bitDepthLuma = br.ReadUE() + 8U;
+    // Chroma bit depth & qpprime_y_zero_transform_bypass_flag;
+    br.ReadUE();
+    br.ReadBit();
+    if (br.ReadBit()) {
+      auto numLists = (3 != info.chromaFormatIdc) ? 8U : 12U;
+      for (auto i = 0U; i < numLists; i++) {
+        if (br.ReadBit()) {
+          SkipH264ScalingList(br, i < 6 ? 16U : 64U);
+        }
+      }
+    }
+    break;
+  default:
+    break;
+  }
+
+  // log2_max_frame_num_minus4;
+  br.ReadUE();
+  auto picOrderCntType = br.ReadUE();
+  if (0 == picOrderCntType) {
+    br.ReadUE();
+  } else if (1 == picOrderCntType) {
+    br.ReadBit();
+    br.ReadSE();
+    br.ReadSE();
+    auto numRefFramesInCycle = br.ReadUE();
+    for (auto i = 0U; i < numRefFramesInCycle && !br.Overrun(); i++) {
+      br.ReadSE();
+    }
+  }
+
+  // max_num_ref_frames & gaps_in_frame_num_value_allowed_flag;
+  br.ReadUE();
+  br.ReadBit();
+
+  auto widthInMbs = br.ReadUE() + 1U;
+  auto heightInMapUnits = br.ReadUE() + 1U;
+  auto frameMbsOnly = br.ReadBit();
+  if (!frameMbsOnly) {
+    br.ReadBit();
+  }
+  // direct_8x8_inference_flag;
+  br.ReadBit();
+
+  info.width = widthInMbs * 16U;
+  info.height = (2U - frameMbsOnly) * heightInMapUnits * 16U;
+
+  if (br.ReadBit()) {
+    auto chromaArrayType = separateColourPlane ? 0U : info.chromaFormatIdc;
+    auto cropUnitX = 1U, cropUnitY = 2U - frameMbsOnly;
+    if (chromaArrayType) {
+      cropUnitX = (3U == chromaArrayType) ? 1U : 2U;
+      cropUnitY *= (1U == chromaArrayType) ? 2U : 1U;
+    }
+
+    auto cropLeft = br.ReadUE(), cropRight = br.ReadUE();
+    auto cropTop = br.ReadUE(), cropBottom = br.ReadUE();
+    info.width -= (cropLeft + cropRight) * cropUnitX;
+    info.height -= (cropTop + cropBottom) * cropUnitY;
+  }
+
+  info.frameRate = 0.0;
+  if (br.ReadBit()) {
+    // aspect_ratio_info_present_flag;
+    if (br.ReadBit() && 255 == br.ReadBits(8)) {
+      br.SkipBits(32);
+    }
+    // overscan_info_present_flag;
+    if (br.ReadBit()) {
+      br.ReadBit();
+    }
+    // video_signal_type_present_flag;
+    if (br.ReadBit()) {
+      br.SkipBits(4);
+      if (br.ReadBit()) {
+        br.SkipBits(24);
+      }
+    }
+    // chroma_loc_info_present_flag;
+    if (br.ReadBit()) {
+      br.ReadUE();
+      br.ReadUE();
+    }
+    // timing_info_present_flag;
+    if (br.ReadBit()) {
+      auto numUnitsInTick = br.ReadBits(32);
+      auto timeScale = br.ReadBits(32);
+      if (numUnitsInTick && !br.Overrun()) {
+        info.frameRate = (double)timeScale / (2.0 * numUnitsInTick);
+      }
+    }
+  }
+
+  return !br.Overrun() && info.width && info.height;
+}
+
+bool VPF::ParseHEVCSps(const uint8_t *nal, size_t size, SpsInfo &info) {
+  if (size < 16U || 33 != ((nal[0] >> 1) & 0x3f)) {
+    return false;
+  }
+
+  vector<uint8_t> rbsp;
+  NalToRbsp(nal + 2, size - 2, rbsp);
+  BitReader br(rbsp.data(), rbsp.size());
+
+  // sps_video_parameter_set_id;
+  br.SkipBits(4);
+  auto maxSubLayersMinus1 = br.ReadBits(3);
+  // sps_temporal_id_nesting_flag;
+  br.ReadBit();
+
+  // General profile, tier & level;
+  br.SkipBits(96);
+
+  uint32_t subLayerProfilePresent[8] = {0}, subLayerLevelPresent[8] = {0};
+  for (auto i = 0U; i < maxSubLayersMinus1; i++) {
+    subLayerProfilePresent[i] = br.ReadBit();
+    subLayerLevelPresent[i] = br.ReadBit();
+  }
+  if (maxSubLayersMinus1) {
+    br.SkipBits(2 * (8 - maxSubLayersMinus1));
+  }
+  for (auto i = 0U; i < maxSubLayersMinus1; i++) {
+    br.SkipBits(subLayerProfilePresent[i] ? 88 : 0);
+    br.SkipBits(subLayerLevelPresent[i] ? 8 : 0);
+  }
+
+  // sps_seq_parameter_set_id;
+  br.ReadUE();
+  info.chromaFormatIdc = br.ReadUE();
+  auto separateColourPlane = 0U;
+  if (3 == info.chromaFormatIdc) {
+    separateColourPlane = br.ReadBit();
+  }
+
+  info.width = br.ReadUE();
+  info.height = br.ReadUE();
+
+  if (br.ReadBit()) {
+    auto chromaArrayType = separateColourPlane ? 0U : info.chromaFormatIdc;
+    auto subWidthC = (1U == chromaArrayType || 2U == chromaArrayType) ? 2U : 1U;
+    auto subHeightC = (1U == chromaArrayType) ? 2U : 1U;
+
+    auto confLeft = br.ReadUE(), confRight = br.ReadUE();
+    auto confTop = br.ReadUE(), confBottom = br.ReadUE();
+    info.width -= (confLeft + confRight) * subWidthC;
+    info.height -= (confTop + confBottom) * subHeightC;
+  }
+
+  info.bitDepthLuma = br.ReadUE() + 8U;
+
+  /* VUI is way deeper in HEVC SPS, after short-term reference picture sets;
+   * Frame rate is taken from container in this case;
+   */
+  info.frameRate = 0.0;
+
+  return !br.Overrun() && info.width && info.height;
+}
+
+NalParser::NalParser(bool is_hevc) : isHEVC(is_hevc) {}
+
+bool NalParser::SetExtradata(const uint8_t *data, size_t size) {
+  ParameterSets sets;
+  if (!ParseExtradata(data, size, isHEVC, sets)) {
+    return false;
+  }
+
+  // Only HEVC PPS affects slice header layout;
+  if (isHEVC) {
+    for (auto &pps : sets.pps) {
+      if (pps.size() > 2U) {
+        ParseHEVCPps(pps.data(), pps.size());
+      }
+    }
+  }
+
+  return true;
+}
+
+void NalParser::ParseAnnexB(const uint8_t *data, size_t size,
+                            AccessUnitInfo &info) {
+  info = AccessUnitInfo();
+  info.temporalId = isHEVC ? 7U : 0U;
+  hasSlice = false;
+
+  const uint8_t *end = data + size;
+  const uint8_t *nal = FindStartCode(data, end);
+
+  while (nal < end) {
+    nal += 3;
+    auto next = FindStartCode(nal, end);
+
+    auto nalEnd = next;
+    while (nalEnd > nal && !nalEnd[-1]) {
+      nalEnd--;
+    }
+
+    ParseNal(nal, nalEnd - nal, info);
+    nal = next;
+  }
+
+  if (!hasSlice) {
+    info.temporalId = 0U;
+  }
+}
+
+void NalParser::ParseLengthPrefixed(const uint8_t *data, size_t size,
+                                    uint32_t nalLengthSize,
+                                    AccessUnitInfo &info) {
+  info = AccessUnitInfo();
+  info.temporalId = isHEVC ? 7U : 0U;
+  hasSlice = false;
+
+  for (size_t pos = 0U; pos + nalLengthSize <= size;) {
+    size_t nalSize = 0U;
+    for (auto i = 0U; i < nalLengthSize; i++) {
+      nalSize = (nalSize << 8) | data[pos + i];
+    }
+    pos += nalLengthSize;
+
+    if (nalSize > size - pos) {
+      break;
+    }
+
+    ParseNal(data + pos, nalSize, info);
+    pos += nalSize;
+  }
+
+  if (!hasSlice) {
+    info.temporalId = 0U;
+  }
+}
+
+void NalParser::ParseNal(const uint8_t *nal, size_t size,
+                         AccessUnitInfo &info) {
+  if (!size) {
+    return;
+  }
+
+  if (isHEVC) {
+    ParseHEVCNal(nal, size, info);
+  } else {
+    ParseH264Nal(nal, size, info);
+  }
+}
+
+void NalParser::ParseH264Nal(const uint8_t *nal, size_t size,
+                             AccessUnitInfo &info) {
+  auto const nalType = nal[0] & 0x1f;
+  auto const nalRefIdc = (nal[0] >> 5) & 0x03;
+  info.nalTypes |= 1ULL << nalType;
+
+  switch (nalType) {
+  case 7:
+    info.hasSPS = true;
+    return;
+  case 8:
+    info.hasPPS = true;
+    return;
+  case 1:
+  case 5:
+    break;
+  default:
+    return;
+  }
+
+  info.isIDR |= (5 == nalType);
+  info.nalRefIdc = max(info.nalRefIdc, (uint32_t)nalRefIdc);
+  info.isReference |= (0 != nalRefIdc);
+
+  if (hasSlice) {
+    return;
+  }
+  hasSlice = true;
+
+  // first_mb_in_slice and slice_type are within first few bytes;
+  NalToRbsp(nal + 1, min<size_t>(size - 1, 16U), rbsp);
+  BitReader br(rbsp.data(), rbsp.size());
+  br.ReadUE();
+  auto sliceType = br.ReadUE();
+  if (br.Overrun()) {
+    return;
+  }
+
+  switch (sliceType % 5) {
+  case 0:
+  case 3:
+    info.sliceType = SLICE_TYPE_P;
+    break;
+  case 1:
+    info.sliceType = SLICE_TYPE_B;
+    break;
+  default:
+    info.sliceType = SLICE_TYPE_I;
+    break;
+  }
+}
+
+void NalParser::ParseHEVCPps(const uint8_t *nal, size_t size) {
+  NalToRbsp(nal + 2, min<size_t>(size - 2, 16U), rbsp);
+  BitReader br(rbsp.data(), rbsp.size());
+
+  auto ppsId = br.ReadUE();
+  // pps_seq_parameter_set_id;
+  br.ReadUE();
+  // dependent_slice_segments_enabled_flag, output_flag_present_flag;
+  br.SkipBits(2U);
+  auto numExtraBits = br.ReadBits(3);
+
+  if (!br.Overrun() && ppsId < maxHEVCPps) {
+    extraSliceHeaderBits[ppsId] = numExtraBits;
+  }
+}
+
+void NalParser::ParseHEVCNal(const uint8_t *nal, size_t size,
+                             AccessUnitInfo &info) {
+  if (size < 2U) {
+    return;
+  }
+
+  auto const nalType = (nal[0] >> 1) & 0x3f;
+  auto const temporalId = (nal[1] & 0x07) ? (nal[1] & 0x07) - 1U : 0U;
+  info.nalTypes |= 1ULL << nalType;
+
+  switch (nalType) {
+  case 32:
+    info.hasVPS = true;
+    return;
+  case 33:
+    info.hasSPS = true;
+    return;
+  case 34:
+    info.hasPPS = true;
+    ParseHEVCPps(nal, size);
+    return;
+  default:
+    if (nalType >= 32) {
+      return;
+    }
+    break;
+  }
+
+  auto const isIRAP = (nalType >= 16 && nalType <= 23);
+  info.isIDR |= (19 == nalType || 20 == nalType);
+  // Sub-layer non-reference pictures have even NAL unit types below 16;
+  info.isReference |= isIRAP || (nalType > 15) || (nalType & 1);
+  info.temporalId = min(info.temporalId, (uint32_t)temporalId);
+
+  if (hasSlice) {
+    return;
+  }
+  hasSlice = true;
+
+  NalToRbsp(nal + 2, min<size_t>(size - 2, 16U), rbsp);
+  BitReader br(rbsp.data(), rbsp.size());
+
+  auto firstSliceSegmentInPic = br.ReadBit();
+  if (isIRAP) {
+    // no_output_of_prior_pics_flag;
+    br.ReadBit();
+  }
+  auto ppsId = br.ReadUE();
+
+  /* Slice segment address length depends on SPS; As access unit starts with
+   * first slice segment, that's no problem in practice;
+   */
+  if (!firstSliceSegmentInPic || ppsId >= maxHEVCPps) {
+    return;
+  }
+
+  br.SkipBits(extraSliceHeaderBits[ppsId]);
+  auto sliceType = br.ReadUE();
+  if (br.Overrun()) {
+    return;
+  }
+
+  switch (sliceType) {
+  case 0:
+    info.sliceType = SLICE_TYPE_B;
+    break;
+  case 1:
+    info.sliceType = SLICE_TYPE_P;
+    break;
+  case 2:
+    info.sliceType = SLICE_TYPE_I;
+    break;
+  default:
+    break;
+  }
+}
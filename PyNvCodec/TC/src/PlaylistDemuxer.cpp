@@ -0,0 +1,360 @@
+/*
+ * Copyright 2020 NVIDIA Corporation
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "PlaylistDemuxer.hpp"
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+
+using namespace std;
+
+PlaylistDemuxer::PlaylistDemuxer(const vector<string> &segments,
+                                 const map<string, string> &ffmpeg_options)
+    : segments(segments), options(ffmpeg_options) {
+  Start();
+}
+
+PlaylistDemuxer::PlaylistDemuxer(const vector<string> &segments,
+                                 shared_ptr<DemuxerPool> pool)
+    : segments(segments), options(pool->GetOptions()), pool(pool) {
+  Start();
+}
+
+void PlaylistDemuxer::Start() {
+  if (segments.empty()) {
+    stringstream ss;
+    ss << __FUNCTION__ << ": no segments given." << endl;
+    throw invalid_argument(ss.str());
+  }
+
+  current.reset(OpenSegment(0U));
+  timebase = current->GetTimebase();
+  hasSegmentStart = current->GetStartTime(segmentStart);
+  segmentOffset = segmentStart;
+  SaveBounds();
+
+  PrefetchNextSegment();
+}
+
+PlaylistDemuxer::~PlaylistDemuxer() {
+  DropNextSegment();
+  ReleaseSegment(current.release());
+}
+
+// Waits for background open to finish as there's no way to cancel it;
+void PlaylistDemuxer::DropNextSegment() {
+  if (next.valid()) {
+    try {
+      ReleaseSegment(next.get());
+    } catch (exception &) {
+    }
+  }
+}
+
+void PlaylistDemuxer::Reopen(const vector<string> &newSegments) {
+  if (newSegments.empty()) {
+    stringstream ss;
+    ss << __FUNCTION__ << ": no segments given." << endl;
+    throw invalid_argument(ss.str());
+  }
+
+  DropNextSegment();
+  interruptHandler.Reset();
+
+  segments = newSegments;
+  segmentIdx = 0U;
+  outputEnd = 0.0;
+  lastPacketData = {};
+  bounds.clear();
+
+  current->Reopen(segments[0].c_str());
+  timebase = current->GetTimebase();
+  hasSegmentStart = current->GetStartTime(segmentStart);
+  segmentOffset = segmentStart;
+  SaveBounds();
+
+  PrefetchNextSegment();
+}
+
+FFmpegDemuxer *PlaylistDemuxer::OpenSegment(size_t idx) const {
+  if (pool) {
+    return pool->Acquire(segments[idx].c_str(), &interruptHandler);
+  }
+  return new FFmpegDemuxer(segments[idx].c_str(), options, &interruptHandler);
+}
+
+void PlaylistDemuxer::ReleaseSegment(FFmpegDemuxer *segment) const {
+  if (segment) {
+    segment->LinkInterrupt(nullptr);
+  }
+
+  if (pool) {
+    pool->Release(segment);
+  } else {
+    delete segment;
+  }
+}
+
+void PlaylistDemuxer::PrefetchNextSegment() {
+  auto const idx = segmentIdx + 1U;
+  if (idx < segments.size()) {
+    next = async(launch::async, [this, idx]() { return OpenSegment(idx); });
+  }
+}
+
+/* Switches to next segment which was opened in background;
+ * Segments which can't be opened are skipped;
+ */
+bool PlaylistDemuxer::NextSegment() {
+  while (next.valid() && !interruptHandler.IsInterrupted()) {
+    unique_ptr<FFmpegDemuxer> segment;
+    try {
+      segment.reset(next.get());
+    } catch (exception &e) {
+      cerr << "Skipping segment " << segments[segmentIdx + 1U] << ": "
+           << e.what() << endl;
+    }
+
+    segmentIdx++;
+    PrefetchNextSegment();
+
+    if (!segment) {
+      continue;
+    }
+
+    if (FILTER_NONE != packetFilter.mode) {
+      segment->SetPacketFilter(packetFilter);
+    }
+
+    swap(current, segment);
+    ReleaseSegment(segment.release());
+
+    // Segment which was read before keeps its place in output timeline;
+    if (segmentIdx < bounds.size() && bounds[segmentIdx].isRead) {
+      auto &b = bounds[segmentIdx];
+      hasSegmentStart = b.hasStart;
+      segmentStart = b.start;
+      segmentOffset = b.offset;
+    } else {
+      hasSegmentStart = current->GetStartTime(segmentStart);
+      segmentOffset = outputEnd;
+      SaveBounds();
+    }
+    return true;
+  }
+
+  return false;
+}
+
+bool PlaylistDemuxer::SwitchSegment(size_t idx) {
+  unique_ptr<FFmpegDemuxer> segment;
+  try {
+    segment.reset(OpenSegment(idx));
+  } catch (exception &e) {
+    cerr << "Can't open segment " << segments[idx] << ": " << e.what()
+         << endl;
+    return false;
+  }
+
+  DropNextSegment();
+  if (FILTER_NONE != packetFilter.mode) {
+    segment->SetPacketFilter(packetFilter);
+  }
+  swap(current, segment);
+  ReleaseSegment(segment.release());
+
+  segmentIdx = idx;
+  auto &b = bounds[segmentIdx];
+  hasSegmentStart = b.hasStart;
+  segmentStart = b.start;
+  segmentOffset = b.offset;
+
+  PrefetchNextSegment();
+  return true;
+}
+
+void PlaylistDemuxer::SaveBounds() {
+  if (bounds.size() <= segmentIdx) {
+    bounds.resize(segmentIdx + 1U);
+  }
+  auto &b = bounds[segmentIdx];
+  b.isRead = true;
+  b.hasStart = hasSegmentStart;
+  b.start = segmentStart;
+  b.offset = segmentOffset;
+}
+
+int64_t PlaylistDemuxer::Rebase(int64_t ts, double streamTimebase,
+                                double outTimebase) const {
+  if (AV_NOPTS_VALUE == ts || !hasSegmentStart) {
+    return ts;
+  }
+
+  if (streamTimebase == outTimebase && segmentStart == segmentOffset) {
+    return ts;
+  }
+
+  return llround((ts * streamTimebase - segmentStart + segmentOffset) /
+                 outTimebase);
+}
+
+void PlaylistDemuxer::RebaseVideo(int64_t &pts, int64_t &dts,
+                                  uint64_t &duration) {
+  auto const streamTimebase = current->GetTimebase();
+
+  // Fall back to first packet if container doesn't tell start time;
+  if (!hasSegmentStart) {
+    auto const ts = (AV_NOPTS_VALUE != dts) ? dts : pts;
+    if (AV_NOPTS_VALUE != ts) {
+      segmentStart = ts * streamTimebase;
+      segmentOffset = segmentIdx ? outputEnd : segmentStart;
+      hasSegmentStart = true;
+      SaveBounds();
+    }
+  }
+
+  pts = Rebase(pts, streamTimebase, timebase);
+  dts = Rebase(dts, streamTimebase, timebase);
+  if (streamTimebase != timebase) {
+    duration = llround(duration * streamTimebase / timebase);
+  }
+
+  if (AV_NOPTS_VALUE != pts) {
+    outputEnd = max(outputEnd, (pts + (int64_t)duration) * timebase);
+  }
+}
+
+AVCodecID PlaylistDemuxer::GetVideoCodec() const {
+  return current->GetVideoCodec();
+}
+
+uint32_t PlaylistDemuxer::GetWidth() const { return current->GetWidth(); }
+
+uint32_t PlaylistDemuxer::GetHeight() const { return current->GetHeight(); }
+
+double PlaylistDemuxer::GetFramerate() const {
+  return current->GetFramerate();
+}
+
+double PlaylistDemuxer::GetTimebase() const { return timebase; }
+
+uint32_t PlaylistDemuxer::GetVideoStreamIndex() const {
+  return current->GetVideoStreamIndex();
+}
+
+AVPixelFormat PlaylistDemuxer::GetPixelFormat() const {
+  return current->GetPixelFormat();
+}
+
+uint32_t PlaylistDemuxer::GetSegmentIndex() const { return segmentIdx; }
+
+bool PlaylistDemuxer::Demux(uint8_t *&pVideo, size_t &rVideoBytes) {
+  do {
+    if (current->Demux(pVideo, rVideoBytes)) {
+      current->GetLastPacketData(lastPacketData);
+      RebaseVideo(lastPacketData.pts, lastPacketData.dts,
+                  lastPacketData.duration);
+      return true;
+    }
+  } while (!current->IsTimedOut() && NextSegment());
+
+  return false;
+}
+
+bool PlaylistDemuxer::DemuxBatch(uint32_t maxPackets, size_t maxBytes,
+                                 uint8_t *&pVideo, size_t &rVideoBytes,
+                                 vector<PacketBatchEntry> &entries) {
+  do {
+    if (current->DemuxBatch(maxPackets, maxBytes, pVideo, rVideoBytes,
+                            entries)) {
+      for (auto &entry : entries) {
+        RebaseVideo(entry.pts, entry.dts, entry.duration);
+      }
+
+      current->GetLastPacketData(lastPacketData);
+      RebaseVideo(lastPacketData.pts, lastPacketData.dts,
+                  lastPacketData.duration);
+      return true;
+    }
+  } while (!current->IsTimedOut() && NextSegment());
+
+  return false;
+}
+
+void PlaylistDemuxer::GetLastPacketData(PacketData &pktData) {
+  pktData = lastPacketData;
+}
+
+const vector<int> &PlaylistDemuxer::GetExtraStreams() const {
+  return current->GetExtraStreams();
+}
+
+bool PlaylistDemuxer::DemuxStream(int streamIndex, uint8_t *&pData,
+                                  size_t &rBytes) {
+  return current->DemuxStream(streamIndex, pData, rBytes);
+}
+
+bool PlaylistDemuxer::GetAudioContext(int streamIndex,
+                                      AudioContext &audioContext) const {
+  if (!current->GetAudioContext(streamIndex, audioContext)) {
+    return false;
+  }
+
+  // Non-video streams keep their own time base;
+  auto &packetData = audioContext.packetData;
+  packetData.pts =
+      Rebase(packetData.pts, audioContext.timeBase, audioContext.timeBase);
+  packetData.dts =
+      Rebase(packetData.dts, audioContext.timeBase, audioContext.timeBase);
+
+  return true;
+}
+
+void PlaylistDemuxer::SetPacketFilter(const PacketFilter &filter) {
+  packetFilter = filter;
+  current->SetPacketFilter(filter);
+}
+
+bool PlaylistDemuxer::Seek(double timestamp) {
+  /* Background open may have been aborted by interrupt, so next segment is
+   * opened again;
+   */
+  if (interruptHandler.IsInterrupted()) {
+    DropNextSegment();
+    interruptHandler.Reset();
+    PrefetchNextSegment();
+  }
+
+  // Last segment read before which starts at or before timestamp;
+  size_t idx = 0U;
+  for (size_t i = 0U; i < bounds.size(); i++) {
+    if (bounds[i].isRead && bounds[i].offset <= timestamp) {
+      idx = i;
+    }
+  }
+
+  if (idx != segmentIdx && !SwitchSegment(idx)) {
+    return false;
+  }
+
+  auto const local =
+      timestamp - segmentOffset + (hasSegmentStart ? segmentStart : 0.0);
+  return current->Seek(local);
+}
+
+// Segment demuxers are linked, so current and next ones are both aborted;
+void PlaylistDemuxer::Interrupt() { interruptHandler.Interrupt(); }
+
+bool PlaylistDemuxer::IsTimedOut() const { return current->IsTimedOut(); }
@@ -0,0 +1,408 @@
+/*
+ * Copyright 2020 NVIDIA Corporation
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "StreamCopyTrimmer.hpp"
+#include "CodecsSupport.hpp"
+#include "MemoryInterfaces.hpp"
+#include "NvCodecCLIOptions.h"
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+#include <vector>
+
+extern "C" {
+#include <libavcodec/avcodec.h>
+#include <libavutil/avutil.h>
+}
+
+using namespace std;
+using namespace VPF;
+
+namespace VPF {
+struct StreamCopyTrimmer_Impl {
+  unique_ptr<DemuxFrame> demuxer;
+  unique_ptr<MuxFrame> muxer;
+
+  // Don't own memory, point to packet and params being written;
+  unique_ptr<Buffer> pPacket;
+  unique_ptr<Buffer> pParams;
+
+  // Last demuxed packet, data is owned by demuxer;
+  const uint8_t *data = nullptr;
+  size_t size = 0U;
+  MuxingParams params;
+
+  // Packet which is kept aside, data is copied;
+  struct PacketCopy {
+    vector<uint8_t> data;
+    MuxingParams params;
+  };
+
+  // Subtracted from timestamps of written packets;
+  int64_t tsOffset = 0;
+  uint32_t numWritten = 0U;
+  bool isUsed = false;
+
+  StreamCopyTrimmer_Impl(const char *input, const char *output,
+                         const map<string, string> &ffmpeg_options) {
+    vector<const char *> options;
+    for (auto &pair : ffmpeg_options) {
+      options.push_back(pair.first.c_str());
+      options.push_back(pair.second.c_str());
+    }
+    demuxer.reset(DemuxFrame::Make(input, options.data(), options.size()));
+    muxer.reset(MuxFrame::Make(output));
+    pPacket.reset(Buffer::Make(0U, nullptr));
+    pParams.reset(Buffer::Make(0U, nullptr));
+  }
+
+  static int64_t Dts(const PacketData &packetData) {
+    return (AV_NOPTS_VALUE != packetData.dts) ? packetData.dts
+                                              : packetData.pts;
+  }
+
+  static bool IsKey(const PacketData &packetData) {
+    return 0U != (packetData.flags & AV_PKT_FLAG_KEY);
+  }
+
+  bool Demux() {
+    if (TASK_EXEC_SUCCESS != demuxer->Execute()) {
+      return false;
+    }
+
+    auto pVideo = (Buffer *)demuxer->GetOutput(0U);
+    auto pMuxParams = (Buffer *)demuxer->GetOutput(1U);
+    if (!pVideo || !pMuxParams) {
+      return false;
+    }
+
+    data = pVideo->GetDataAs<uint8_t>();
+    size = pVideo->GetRawMemSize();
+    params = *pMuxParams->GetDataAs<MuxingParams>();
+    return true;
+  }
+
+  void Write(const uint8_t *pData, size_t dataSize, MuxingParams muxParams) {
+    auto &packetData = muxParams.videoContext.packetData;
+    if (AV_NOPTS_VALUE != packetData.pts) {
+      packetData.pts -= tsOffset;
+    }
+    if (AV_NOPTS_VALUE != packetData.dts) {
+      packetData.dts -= tsOffset;
+    }
+
+    pPacket->Update(dataSize, (void *)pData);
+    pParams->Update(sizeof(muxParams), &muxParams);
+    muxer->SetInput(pPacket.get(), 0U);
+    muxer->SetInput(pParams.get(), 1U);
+
+    if (TASK_EXEC_SUCCESS != muxer->Execute()) {
+      stringstream ss;
+      ss << __FUNCTION__ << ": can't write packet " << numWritten;
+      throw runtime_error(ss.str());
+    }
+    numWritten++;
+  }
+
+  // Seeks to start and reads until first keyframe;
+  bool FindKeyframe(double start) {
+    if (isUsed) {
+      stringstream ss;
+      ss << __FUNCTION__ << ": trimmer writes single output only";
+      throw runtime_error(ss.str());
+    }
+    isUsed = true;
+
+    // Muxer writes single video stream only;
+    cerr << "Trimmed output is video-only, audio and other streams of input "
+         << "are dropped" << endl;
+
+    MuxingParams inParams;
+    demuxer->GetParams(inParams);
+    if (inParams.videoContext.timeBase <= 0.0) {
+      stringstream ss;
+      ss << __FUNCTION__ << ": input time base is unknown";
+      throw runtime_error(ss.str());
+    }
+
+    if (!demuxer->Seek(start)) {
+      cerr << "Trimming from the beginning of input" << endl;
+    }
+
+    while (Demux()) {
+      if (IsKey(params.videoContext.packetData)) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  int64_t ToTs(double seconds) const {
+    return (int64_t)llround(seconds / params.videoContext.timeBase);
+  }
+
+  /* Copies packets shown before end, starting with current one;
+   * Reading goes on past end by reorder delay. Packets shown after end are
+   * written only if packet shown before end follows them in decode order,
+   * as it may refer to them;
+   */
+  void Copy(int64_t endTs, bool hasPacket) {
+    vector<PacketCopy> held;
+    int64_t delay = 0;
+    while (hasPacket) {
+      auto const &packetData = params.videoContext.packetData;
+      auto const dts = Dts(packetData);
+      auto const pts =
+          (AV_NOPTS_VALUE != packetData.pts) ? packetData.pts : dts;
+      if (AV_NOPTS_VALUE != packetData.pts &&
+          AV_NOPTS_VALUE != packetData.dts) {
+        delay = max(delay, packetData.pts - packetData.dts);
+      }
+
+      if (AV_NOPTS_VALUE != dts && dts >= endTs + delay) {
+        break;
+      }
+
+      if (AV_NOPTS_VALUE != pts && pts >= endTs) {
+        held.push_back({vector<uint8_t>(data, data + size), params});
+      } else {
+        for (auto &packet : held) {
+          Write(packet.data.data(), packet.data.size(), packet.params);
+        }
+        held.clear();
+        Write(data, size, params);
+      }
+      hasPacket = Demux();
+    }
+  }
+
+  bool Reencode(int64_t startTs, int64_t endTs, CUcontext context,
+                CUstream stream, const map<string, string> &enc_options);
+};
+} // namespace VPF
+
+/* Leading GOP is collected, decoded and frames which precede start or follow
+ * end are dropped. Rest is encoded again and given timestamps of frames they
+ * come from, so they fit packets which are copied after;
+ * Whole GOP is collected, as frames shown before end may come after it in
+ * decode order;
+ * Returns true if there's current packet to continue with;
+ */
+bool StreamCopyTrimmer_Impl::Reencode(int64_t startTs, int64_t endTs,
+                                      CUcontext context, CUstream stream,
+                                      const map<string, string> &enc_options) {
+  vector<PacketCopy> gop;
+  bool hasPacket = true;
+  do {
+    gop.push_back({vector<uint8_t>(data, data + size), params});
+    hasPacket = Demux();
+  } while (hasPacket && !IsKey(params.videoContext.packetData));
+
+  /* Decoder outputs frames in display order, so frames to drop are those
+   * with lowest pts;
+   */
+  uint32_t numDropped = 0U;
+  vector<int64_t> keptPts;
+  for (auto &packet : gop) {
+    auto const pts = packet.params.videoContext.packetData.pts;
+    if (pts < startTs) {
+      numDropped++;
+    } else if (pts < endTs) {
+      keptPts.push_back(pts);
+    }
+  }
+  sort(keptPts.begin(), keptPts.end());
+
+  /* Copied packets keep their dts, so encoded ones need same reorder delay;
+   * It's taken from next keyframe;
+   */
+  int64_t delay = 0;
+  if (hasPacket && IsKey(params.videoContext.packetData)) {
+    auto &next = params.videoContext.packetData;
+    if (AV_NOPTS_VALUE != next.pts && AV_NOPTS_VALUE != next.dts) {
+      delay = max<int64_t>(0, next.pts - next.dts);
+    }
+  }
+
+  if (keptPts.empty()) {
+    if (hasPacket) {
+      tsOffset = Dts(params.videoContext.packetData);
+    }
+    return hasPacket;
+  }
+  tsOffset = keptPts.front() - delay;
+
+  unique_ptr<NvdecDecodeFrame> decoder(NvdecDecodeFrame::Make(
+      stream, context, params.videoContext.codec, 4U, params.videoContext.width,
+      params.videoContext.height));
+  unique_ptr<NvencEncodeFrame> encoder;
+  unique_ptr<NvEncoderClInterface> cli;
+  vector<vector<uint8_t>> encoded;
+
+  auto collect = [&]() {
+    auto pEncoded = (Buffer *)encoder->GetOutput(0U);
+    if (!pEncoded) {
+      return false;
+    }
+    auto pData = pEncoded->GetDataAs<uint8_t>();
+    encoded.emplace_back(pData, pData + pEncoded->GetRawMemSize());
+    return true;
+  };
+
+  uint32_t frameIdx = 0U;
+  auto onSurface = [&](Surface *pSurface) {
+    auto const idx = frameIdx++;
+    if (idx < numDropped || idx >= numDropped + keptPts.size()) {
+      return;
+    }
+
+    // Encoder is created lazily as decoded frame size may differ from coded;
+    if (!encoder) {
+      auto options = enc_options;
+      stringstream res;
+      res << pSurface->Width() << "x" << pSurface->Height();
+      options.emplace("s", res.str());
+      options.emplace("codec", cudaVideoCodec_HEVC == params.videoContext.codec
+                                   ? "hevc"
+                                   : "h264");
+      /* P frames only (it's frameIntervalP), so reorder delay doesn't exceed
+       * one of copied packets. Caller can't override that;
+       */
+      options["bf"] = "1";
+      if (params.videoContext.frameRate > 0.0) {
+        options.emplace("fps",
+                        to_string(lround(params.videoContext.frameRate)));
+      }
+      cli.reset(new NvEncoderClInterface(options));
+      encoder.reset(NvencEncodeFrame::Make(stream, context, *cli,
+                                           NV_ENC_BUFFER_FORMAT_NV12,
+                                           pSurface->Width(),
+                                           pSurface->Height(), false));
+    }
+
+    encoder->SetInput(pSurface, 0U);
+    if (TASK_EXEC_SUCCESS != encoder->Execute()) {
+      stringstream ss;
+      ss << __FUNCTION__ << ": can't encode frame " << idx;
+      throw runtime_error(ss.str());
+    }
+    collect();
+  };
+
+  for (auto &packet : gop) {
+    unique_ptr<Buffer> pInput(
+        Buffer::Make(packet.data.size(), (void *)packet.data.data()));
+    decoder->SetInput(pInput.get(), 0U);
+    if (TASK_EXEC_SUCCESS != decoder->Execute()) {
+      stringstream ss;
+      ss << __FUNCTION__ << ": can't decode leading GOP";
+      throw runtime_error(ss.str());
+    }
+    auto pSurface = (Surface *)decoder->GetOutput(0U);
+    if (pSurface) {
+      onSurface(pSurface);
+    }
+  }
+
+  // Empty input flushes decoder;
+  unique_ptr<Buffer> pFlush(Buffer::Make(0U, nullptr));
+  decoder->SetInput(pFlush.get(), 0U);
+  while (TASK_EXEC_SUCCESS == decoder->Execute()) {
+    auto pSurface = (Surface *)decoder->GetOutput(0U);
+    if (!pSurface) {
+      break;
+    }
+    onSurface(pSurface);
+  }
+
+  // No input flushes encoder;
+  if (encoder) {
+    encoder->SetInput(nullptr, 0U);
+    while (TASK_EXEC_SUCCESS == encoder->Execute() && collect()) {
+    }
+  }
+
+  // Every kept frame has to take its own timestamp;
+  if (encoded.size() != keptPts.size()) {
+    stringstream ss;
+    ss << __FUNCTION__ << ": " << keptPts.size() << " frames of leading GOP "
+       << "were to be encoded, got " << encoded.size() << " packets";
+    throw runtime_error(ss.str());
+  }
+
+  auto muxParams = gop.front().params;
+  auto &packetData = muxParams.videoContext.packetData;
+  for (size_t i = 0U; i < encoded.size(); i++) {
+    packetData.pts = keptPts[i];
+    packetData.dts = keptPts[i] - delay;
+    packetData.flags = (0U == i) ? AV_PKT_FLAG_KEY : 0U;
+    Write(encoded[i].data(), encoded[i].size(), muxParams);
+  }
+
+  return hasPacket;
+}
+
+StreamCopyTrimmer::StreamCopyTrimmer(const char *input, const char *output,
+                                     const map<string, string> &ffmpeg_options)
+    : pImpl(new StreamCopyTrimmer_Impl(input, output, ffmpeg_options)) {}
+
+StreamCopyTrimmer::~StreamCopyTrimmer() { delete pImpl; }
+
+uint32_t StreamCopyTrimmer::Trim(double start, double end) {
+  if (end <= start) {
+    stringstream ss;
+    ss << __FUNCTION__ << ": end must be greater than start";
+    throw invalid_argument(ss.str());
+  }
+
+  if (!pImpl->FindKeyframe(start)) {
+    return 0U;
+  }
+
+  pImpl->tsOffset =
+      StreamCopyTrimmer_Impl::Dts(pImpl->params.videoContext.packetData);
+  pImpl->Copy(pImpl->ToTs(end), true);
+  return pImpl->numWritten;
+}
+
+uint32_t StreamCopyTrimmer::TrimReencode(
+    double start, double end, CUcontext context, CUstream stream,
+    const map<string, string> &enc_options) {
+  if (end <= start) {
+    stringstream ss;
+    ss << __FUNCTION__ << ": end must be greater than start";
+    throw invalid_argument(ss.str());
+  }
+
+  if (!pImpl->FindKeyframe(start)) {
+    return 0U;
+  }
+
+  auto const startTs = pImpl->ToTs(start), endTs = pImpl->ToTs(end);
+  auto &packetData = pImpl->params.videoContext.packetData;
+
+  // Keyframe is exactly at start, nothing to re-encode;
+  if (AV_NOPTS_VALUE == packetData.pts || packetData.pts >= startTs) {
+    pImpl->tsOffset = StreamCopyTrimmer_Impl::Dts(packetData);
+    pImpl->Copy(endTs, true);
+    return pImpl->numWritten;
+  }
+
+  auto hasPacket =
+      pImpl->Reencode(startTs, endTs, context, stream, enc_options);
+  pImpl->Copy(endTs, hasPacket);
+  return pImpl->numWritten;
+}
@@ -12,6 +12,7 @@
  */
 
 #include <chrono>
+#include <climits>
 #include <fstream>
 #include <map>
 #include <queue>
@@ -31,6 +32,7 @@
 
 #include "FFmpegDemuxer.h"
 #include "NvDecoder.h"
+#include "PlaylistDemuxer.hpp"
 
 using namespace VPF;
 using namespace std;
@@ -38,6 +40,7 @@ using namespace chrono;
 
 constexpr auto TASK_EXEC_SUCCESS = TaskExecStatus::TASK_EXEC_SUCCESS;
 constexpr auto TASK_EXEC_FAIL = TaskExecStatus::TASK_EXEC_FAIL;
+constexpr auto TASK_EXEC_TIMEOUT = TaskExecStatus::TASK_EXEC_TIMEOUT;
 
 namespace VPF {
 
@@ -508,35 +511,68 @@ TaskExecStatus CudaDownloadSurface::Execute() {
 namespace VPF {
 struct DemuxFrame_Impl {
   size_t videoBytes = 0U;
-  FFmpegDemuxer demuxer;
+  PlaylistDemuxer demuxer;
   Buffer *pElementaryVideo;
   Buffer *pMuxingParams;
+  Buffer *pBatchEntries;
+  Buffer *pStreamPacket;
+  vector<PacketBatchEntry> batchEntries;
 
   DemuxFrame_Impl() = delete;
   DemuxFrame_Impl(const DemuxFrame_Impl &other) = delete;
   DemuxFrame_Impl &operator=(const DemuxFrame_Impl &other) = delete;
 
-  explicit DemuxFrame_Impl(const string &url,
+  explicit DemuxFrame_Impl(const vector<string> &segments,
                            const map<string, string> &ffmpeg_options)
-      : demuxer(url.c_str(), ffmpeg_options) {
+      : demuxer(segments, ffmpeg_options) {
+    AllocOutputs();
+  }
+
+  DemuxFrame_Impl(const vector<string> &segments,
+                  shared_ptr<DemuxerPool> pool)
+      : demuxer(segments, pool) {
+    AllocOutputs();
+  }
+
+  void AllocOutputs() {
     pElementaryVideo = Buffer::MakeOwnMem(0U);
     pMuxingParams = Buffer::MakeOwnMem(sizeof(MuxingParams));
+    pBatchEntries = Buffer::MakeOwnMem(0U);
+    pStreamPacket = Buffer::MakeOwnMem(0U);
   }
 
   ~DemuxFrame_Impl() {
     delete pElementaryVideo;
     delete pMuxingParams;
+    delete pBatchEntries;
+    delete pStreamPacket;
   }
 };
 } // namespace VPF
 
 DemuxFrame *DemuxFrame::Make(const char *url, const char **ffmpeg_options,
                              uint32_t opts_size) {
-  return new DemuxFrame(url, ffmpeg_options, opts_size);
+  return new DemuxFrame(vector<string>(1U, url), ffmpeg_options, opts_size);
+}
+
+DemuxFrame *DemuxFrame::Make(const vector<string> &segments,
+                             const char **ffmpeg_options, uint32_t opts_size) {
+  return new DemuxFrame(segments, ffmpeg_options, opts_size);
+}
+
+DemuxFrame *DemuxFrame::Make(const vector<string> &segments,
+                             shared_ptr<DemuxerPool> pool) {
+  return new DemuxFrame(segments, pool);
+}
+
+DemuxFrame::DemuxFrame(const vector<string> &segments,
+                       shared_ptr<DemuxerPool> pool)
+    : Task("DemuxFrame", DemuxFrame::numInputs, DemuxFrame::numOutputs) {
+  pImpl = new DemuxFrame_Impl(segments, pool);
 }
 
-DemuxFrame::DemuxFrame(const char *url, const char **ffmpeg_options,
-                       uint32_t opts_size)
+DemuxFrame::DemuxFrame(const vector<string> &segments,
+                       const char **ffmpeg_options, uint32_t opts_size)
     : Task("DemuxFrame", DemuxFrame::numInputs, DemuxFrame::numOutputs) {
   map<string, string> options;
   if (0 == opts_size % 2) {
@@ -549,7 +585,7 @@ DemuxFrame::DemuxFrame(const char *url, const char **ffmpeg_options,
       options.insert(pair<string, string>(key, value));
     }
   }
-  pImpl = new DemuxFrame_Impl(url, options);
+  pImpl = new DemuxFrame_Impl(segments, options);
 }
 
 DemuxFrame::~DemuxFrame() { delete pImpl; }
@@ -564,7 +600,7 @@ TaskExecStatus DemuxFrame::Execute() {
   auto &demuxer = pImpl->demuxer;
 
   if (!demuxer.Demux(pVideo, videoBytes)) {
-    return TASK_EXEC_FAIL;
+    return demuxer.IsTimedOut() ? TASK_EXEC_TIMEOUT : TASK_EXEC_FAIL;
   }
 
   if (videoBytes) {
@@ -580,6 +616,81 @@ TaskExecStatus DemuxFrame::Execute() {
   return TASK_EXEC_SUCCESS;
 }
 
+TaskExecStatus DemuxFrame::DemuxBatch(uint32_t numPackets, size_t byteBudget) {
+  ClearOutputs();
+
+  uint8_t *pVideo = nullptr;
+  MuxingParams params = {0};
+
+  auto &videoBytes = pImpl->videoBytes;
+  auto &entries = pImpl->batchEntries;
+  auto &demuxer = pImpl->demuxer;
+
+  if (!demuxer.DemuxBatch(numPackets, byteBudget, pVideo, videoBytes,
+                          entries)) {
+    return demuxer.IsTimedOut() ? TASK_EXEC_TIMEOUT : TASK_EXEC_FAIL;
+  }
+
+  pImpl->pElementaryVideo->Update(videoBytes, pVideo);
+  SetOutput(pImpl->pElementaryVideo, 0U);
+
+  // Muxing params carry data of the last packet in batch;
+  GetParams(params);
+  pImpl->demuxer.GetLastPacketData(params.videoContext.packetData);
+  pImpl->pMuxingParams->Update(sizeof(MuxingParams), &params);
+  SetOutput(pImpl->pMuxingParams, 1U);
+
+  pImpl->pBatchEntries->Update(entries.size() * sizeof(PacketBatchEntry),
+                               entries.data());
+  SetOutput(pImpl->pBatchEntries, 2U);
+
+  return TASK_EXEC_SUCCESS;
+}
+
+void DemuxFrame::Reopen(const vector<string> &segments) {
+  ClearOutputs();
+  pImpl->demuxer.Reopen(segments);
+}
+
+bool DemuxFrame::Seek(double timestamp) {
+  ClearOutputs();
+  return pImpl->demuxer.Seek(timestamp);
+}
+
+uint32_t DemuxFrame::GetSegmentIndex() const {
+  return pImpl->demuxer.GetSegmentIndex();
+}
+
+TaskExecStatus DemuxFrame::DemuxStream(uint32_t streamIndex) {
+  ClearOutputs();
+
+  uint8_t *pData = nullptr;
+  size_t dataBytes = 0U;
+  MuxingParams params = {0};
+
+  auto &demuxer = pImpl->demuxer;
+  if (!demuxer.DemuxStream(streamIndex, pData, dataBytes)) {
+    return demuxer.IsTimedOut() ? TASK_EXEC_TIMEOUT : TASK_EXEC_FAIL;
+  }
+
+  pImpl->pStreamPacket->Update(dataBytes, pData);
+  SetOutput(pImpl->pStreamPacket, 3U);
+
+  GetParams(params);
+  demuxer.GetLastPacketData(params.videoContext.packetData);
+  demuxer.GetAudioContext(streamIndex, params.audioContext);
+  pImpl->pMuxingParams->Update(sizeof(MuxingParams), &params);
+  SetOutput(pImpl->pMuxingParams, 1U);
+
+  return TASK_EXEC_SUCCESS;
+}
+
+void DemuxFrame::Interrupt() { pImpl->demuxer.Interrupt(); }
+
+const vector<int> &DemuxFrame::GetExtraStreams() const {
+  return pImpl->demuxer.GetExtraStreams();
+}
+
 void DemuxFrame::GetParams(MuxingParams &params) const {
   params.videoContext.width = pImpl->demuxer.GetWidth();
   params.videoContext.height = pImpl->demuxer.GetHeight();
@@ -615,7 +726,12 @@ private:
     }
 
     videoStream->index = videoCtx.streamIndex;
-    videoStream->time_base = av_make_q(1, videoCtx.frameRate);
+    /* Packets carry timestamps in demuxer time base. If it's not known,
+     * muxer has to generate timestamps on it's own;
+     */
+    videoStream->time_base = (videoCtx.timeBase > 0.0)
+                                 ? av_d2q(videoCtx.timeBase, INT_MAX)
+                                 : av_make_q(1, videoCtx.frameRate);
 
     AVCodecParameters *videoCodecParams = videoStream->codecpar;
     videoCodecParams->codec_type = AVMEDIA_TYPE_VIDEO;
@@ -738,9 +854,22 @@ TaskExecStatus MuxFrame::Execute() {
     pkt.data = (uint8_t *)elementaryData.GetRawMemPtr();
     pkt.stream_index = FindMappedStreamIndex(streamMapping, nativeStreamIndex);
 
-    auto timeBase = stream->time_base;
     auto &packetData = muxParams.videoContext.packetData;
     pkt.pos = -1;
+    pkt.flags = packetData.flags;
+
+    if (muxParams.videoContext.timeBase > 0.0) {
+      auto const timeBase = av_d2q(muxParams.videoContext.timeBase, INT_MAX);
+      auto rescale = [&](int64_t ts) {
+        return (AV_NOPTS_VALUE == ts)
+                   ? ts
+                   : av_rescale_q(ts, timeBase, stream->time_base);
+      };
+      pkt.pts = rescale(packetData.pts);
+      pkt.dts = rescale(packetData.dts);
+      pkt.duration =
+          av_rescale_q(packetData.duration, timeBase, stream->time_base);
+    }
 
     auto ret = av_interleaved_write_frame(outFmtCtx, &pkt);
     if (ret < 0) {
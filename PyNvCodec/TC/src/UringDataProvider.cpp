@@ -0,0 +1,329 @@
+/*
+ * Copyright 2020 NVIDIA Corporation
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifdef USE_IO_URING
+
+#include "UringDataProvider.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <iostream>
+#include <liburing.h>
+#include <sstream>
+#include <stdexcept>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+using namespace std;
+
+static const size_t pageSize = 4096U;
+
+UringService::UringService(uint32_t queueDepth, uint32_t numBuffers,
+                           uint32_t bufferSize)
+    : ring(new io_uring), bufferSize(bufferSize) {
+  auto ret = io_uring_queue_init(queueDepth, ring.get(), 0);
+  if (ret < 0) {
+    stringstream ss;
+    ss << __FUNCTION__ << ": can't init io_uring: " << strerror(-ret);
+    throw runtime_error(ss.str());
+  }
+
+  /* Registered buffers save page pinning on every read. Registration may
+   * fail because of RLIMIT_MEMLOCK, plain reads are used then;
+   */
+  if (numBuffers && bufferSize &&
+      0 == posix_memalign((void **)&bufferMem, pageSize,
+                          (size_t)numBuffers * bufferSize)) {
+    vector<iovec> iovecs(numBuffers);
+    for (uint32_t i = 0U; i < numBuffers; i++) {
+      iovecs[i].iov_base = bufferMem + (size_t)i * bufferSize;
+      iovecs[i].iov_len = bufferSize;
+      freeBuffers.push_back(i);
+    }
+
+    ret = io_uring_register_buffers(ring.get(), iovecs.data(), numBuffers);
+    isRegistered = (0 == ret);
+    if (!isRegistered) {
+      cerr << "Can't register io_uring buffers: " << strerror(-ret) << endl;
+    }
+  }
+
+  reaper = thread(&UringService::Reap, this);
+}
+
+UringService::~UringService() {
+  // NOP without request stops reaper;
+  {
+    lock_guard<mutex> lock(submitMutex);
+    auto sqe = io_uring_get_sqe(ring.get());
+    if (!sqe) {
+      io_uring_submit(ring.get());
+      sqe = io_uring_get_sqe(ring.get());
+    }
+    io_uring_prep_nop(sqe);
+    io_uring_sqe_set_data(sqe, nullptr);
+    io_uring_submit(ring.get());
+    numQueued = 0U;
+  }
+  reaper.join();
+
+  io_uring_queue_exit(ring.get());
+  free(bufferMem);
+}
+
+shared_ptr<UringService> UringService::GetShared() {
+  static mutex sharedMutex;
+  static weak_ptr<UringService> shared;
+
+  lock_guard<mutex> lock(sharedMutex);
+  auto service = shared.lock();
+  if (!service) {
+    service = make_shared<UringService>();
+    shared = service;
+  }
+  return service;
+}
+
+int UringService::AcquireBuffer(uint8_t *&buffer) {
+  lock_guard<mutex> lock(bufferMutex);
+  if (!isRegistered || freeBuffers.empty()) {
+    return -1;
+  }
+
+  auto const index = freeBuffers.back();
+  freeBuffers.pop_back();
+  buffer = bufferMem + (size_t)index * bufferSize;
+  return index;
+}
+
+void UringService::ReleaseBuffer(int bufferIndex) {
+  if (bufferIndex < 0) {
+    return;
+  }
+
+  lock_guard<mutex> lock(bufferMutex);
+  freeBuffers.push_back(bufferIndex);
+}
+
+void UringService::Queue(Request &request) {
+  request.isDone = false;
+
+  lock_guard<mutex> lock(submitMutex);
+  auto sqe = io_uring_get_sqe(ring.get());
+  if (!sqe) {
+    // Submission queue is full, make room;
+    io_uring_submit(ring.get());
+    numQueued = 0U;
+    sqe = io_uring_get_sqe(ring.get());
+  }
+
+  if (!sqe) {
+    stringstream ss;
+    ss << __FUNCTION__ << ": io_uring submission queue is full";
+    throw runtime_error(ss.str());
+  }
+
+  if (request.bufferIndex >= 0) {
+    io_uring_prep_read_fixed(sqe, request.fd, request.buffer, request.size,
+                             request.offset, request.bufferIndex);
+  } else {
+    io_uring_prep_read(sqe, request.fd, request.buffer, request.size,
+                       request.offset);
+  }
+  io_uring_sqe_set_data(sqe, &request);
+  numQueued++;
+}
+
+void UringService::Flush() {
+  lock_guard<mutex> lock(submitMutex);
+  if (numQueued) {
+    io_uring_submit(ring.get());
+    numQueued = 0U;
+  }
+}
+
+int32_t UringService::Wait(Request &request) {
+  Flush();
+
+  unique_lock<mutex> lock(doneMutex);
+  doneCv.wait(lock, [&]() { return request.isDone; });
+  return request.result;
+}
+
+void UringService::Reap() {
+  while (true) {
+    io_uring_cqe *cqe = nullptr;
+    auto ret = io_uring_wait_cqe(ring.get(), &cqe);
+    if (-EINTR == ret) {
+      continue;
+    } else if (ret < 0) {
+      cerr << "io_uring completion wait failed: " << strerror(-ret) << endl;
+      return;
+    }
+
+    auto request = (Request *)io_uring_cqe_get_data(cqe);
+    auto const result = cqe->res;
+    io_uring_cqe_seen(ring.get(), cqe);
+
+    if (!request) {
+      return;
+    }
+
+    {
+      lock_guard<mutex> lock(doneMutex);
+      request->result = result;
+      request->isDone = true;
+    }
+    doneCv.notify_all();
+  }
+}
+
+UringDataProvider::UringDataProvider(const char *szFilePath,
+                                     shared_ptr<UringService> service)
+    : service(service) {
+  fd = open(szFilePath, O_RDONLY);
+  if (fd < 0) {
+    stringstream ss;
+    ss << __FUNCTION__ << ": can't open " << szFilePath << ": "
+       << strerror(errno);
+    throw runtime_error(ss.str());
+  }
+
+  struct stat st;
+  if (0 != fstat(fd, &st) || !S_ISREG(st.st_mode)) {
+    close(fd);
+    stringstream ss;
+    ss << __FUNCTION__ << ": " << szFilePath << " isn't a regular file";
+    throw runtime_error(ss.str());
+  }
+  fileSize = st.st_size;
+
+  for (auto &chunk : chunks) {
+    auto &request = chunk.request;
+    request.fd = fd;
+    request.size = service->GetBufferSize();
+    request.bufferIndex = service->AcquireBuffer(request.buffer);
+    if (request.bufferIndex < 0) {
+      chunk.ownMem.resize(request.size);
+      request.buffer = chunk.ownMem.data();
+    }
+  }
+}
+
+UringDataProvider::~UringDataProvider() {
+  // Kernel may still write to buffers;
+  for (auto &chunk : chunks) {
+    Drain(chunk);
+    service->ReleaseBuffer(chunk.request.bufferIndex);
+  }
+  close(fd);
+}
+
+void UringDataProvider::Drain(Chunk &chunk) {
+  // Completion status is only read through service;
+  if (chunk.isValid) {
+    service->Wait(chunk.request);
+  }
+}
+
+void UringDataProvider::Read(Chunk &chunk, int64_t offset) {
+  Drain(chunk);
+  chunk.request.offset = offset;
+  chunk.isValid = true;
+  service->Queue(chunk.request);
+}
+
+int UringDataProvider::GetData(uint8_t *pBuf, int nBuf) {
+  if (position >= fileSize) {
+    return AVERROR_EOF;
+  }
+
+  auto isInside = [&](const Chunk &chunk) {
+    return chunk.isValid && position >= chunk.request.offset &&
+           position < chunk.request.offset + chunk.request.size;
+  };
+
+  if (!isInside(chunks[current]) && isInside(chunks[1U - current])) {
+    current = 1U - current;
+  }
+
+  auto &chunk = chunks[current];
+  auto &request = chunk.request;
+  if (!isInside(chunk)) {
+    Read(chunk, position);
+  }
+
+  auto const result = service->Wait(request);
+  if (result < 0) {
+    chunk.isValid = false;
+    return AVERROR(-result);
+  }
+
+  auto const chunkEnd = request.offset + result;
+  if (position >= chunkEnd) {
+    // Short read, file may have been truncated;
+    chunk.isValid = false;
+    return AVERROR_EOF;
+  }
+
+  /* Read next chunk ahead, unless it's already there;
+   * It's submitted right away so that it's in flight while current chunk is
+   * copied and consumed;
+   */
+  auto &next = chunks[1U - current];
+  if (chunkEnd < fileSize &&
+      !(next.isValid && next.request.offset == chunkEnd)) {
+    Read(next, chunkEnd);
+    service->Flush();
+  }
+
+  auto const numBytes = (int)min<int64_t>(nBuf, chunkEnd - position);
+  memcpy(pBuf, request.buffer + (position - request.offset), numBytes);
+  position += numBytes;
+
+  if (position == chunkEnd) {
+    current = 1U - current;
+  }
+
+  return numBytes;
+}
+
+int64_t UringDataProvider::Seek(int64_t offset, int whence) {
+  switch (whence & ~AVSEEK_FORCE) {
+  case AVSEEK_SIZE:
+    return fileSize;
+  case SEEK_SET:
+    break;
+  case SEEK_CUR:
+    offset += position;
+    break;
+  case SEEK_END:
+    offset += fileSize;
+    break;
+  default:
+    return AVERROR(EINVAL);
+  }
+
+  if (offset < 0) {
+    return AVERROR(EINVAL);
+  }
+
+  // Chunks are kept, they're reused if new position is within them;
+  position = offset;
+  return position;
+}
+
+#endif
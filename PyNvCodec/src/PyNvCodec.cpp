@@ -11,13 +11,18 @@
  * limitations under the License.
  */
 
+#include "BitstreamStats.hpp"
+#include "DemuxerPool.hpp"
+#include "InterruptHandler.hpp"
 #include "MemoryInterfaces.hpp"
 #include "NvCodecCLIOptions.h"
+#include "StreamCopyTrimmer.hpp"
 #include "TC_CORE.hpp"
 #include "Tasks.hpp"
 
 #include <chrono>
 #include <cuda_runtime.h>
+#include <limits>
 #include <mutex>
 #include <pybind11/numpy.h>
 #include <pybind11/pybind11.h>
@@ -37,6 +42,24 @@ namespace py = pybind11;
 
 constexpr auto TASK_EXEC_SUCCESS = TaskExecStatus::TASK_EXEC_SUCCESS;
 constexpr auto TASK_EXEC_FAIL = TaskExecStatus::TASK_EXEC_FAIL;
+constexpr auto TASK_EXEC_TIMEOUT = TaskExecStatus::TASK_EXEC_TIMEOUT;
+
+/* Runs task method which may block on I/O;
+ * GIL is released meanwhile so that I/O can be interrupted from another
+ * Python thread. Timeout is reported as TimeoutException;
+ */
+template <typename F> static TaskExecStatus RunBlocking(F func) {
+  TaskExecStatus status;
+  {
+    py::gil_scoped_release release;
+    status = func();
+  }
+
+  if (TASK_EXEC_TIMEOUT == status) {
+    throw TimeoutException();
+  }
+  return status;
+}
 
 static auto ThrowOnCudaError = [](CUresult res, int lineNum = -1) {
   if (CUDA_SUCCESS != res) {
@@ -324,9 +347,52 @@ struct MotionVector {
   int motion_scale;
 };
 
+/* Runs software decoder which writes straight into given array if its size
+ * matches the frame, which is the case for every frame but the first one
+ * (and those after resolution change). Otherwise array is resized and frame
+ * is copied;
+ */
+static bool DecodeIntoArray(Task *decoder, py::array_t<uint8_t> &frame) {
+  unique_ptr<Buffer> dst;
+  if (frame.size()) {
+    dst.reset(Buffer::Make(frame.size(), frame.mutable_data()));
+  }
+
+  /* Input is cleared before RunBlocking() may throw, so that task doesn't
+   * keep pointer to destination;
+   */
+  decoder->SetInput((Token *)dst.get(), 0U);
+  auto const res = RunBlocking([decoder]() {
+    auto const status = decoder->Execute();
+    decoder->SetInput(nullptr, 0U);
+    return status;
+  });
+
+  auto pRawFrame = (Buffer *)decoder->GetOutput(0U);
+  if (TASK_EXEC_SUCCESS != res || !pRawFrame) {
+    return false;
+  }
+
+  if (pRawFrame != dst.get()) {
+    auto const frame_size = pRawFrame->GetRawMemSize();
+    if (frame_size != frame.size()) {
+      frame.resize({frame_size}, false);
+    }
+
+    memcpy(frame.mutable_data(), pRawFrame->GetRawMemPtr(), frame_size);
+  }
+
+  return true;
+}
+
 class PyFfmpegDecoder {
   unique_ptr<FfmpegDecodeFrame> upDecoder = nullptr;
 
+  /* Frame which didn't fit into previous batch because of resolution change.
+   * It's kept as decoder output until next batch starts with it;
+   */
+  bool hasPendingFrame = false;
+
 public:
   PyFfmpegDecoder(const string &pathToFile,
                   const map<string, string> &ffmpeg_options) {
@@ -335,19 +401,125 @@ public:
   }
 
   bool DecodeSingleFrame(py::array_t<uint8_t> &frame) {
-    if (TASK_EXEC_SUCCESS == upDecoder->Execute()) {
-      auto pRawFrame = (Buffer *)upDecoder->GetOutput(0U);
-      if (pRawFrame) {
-        auto const frame_size = pRawFrame->GetRawMemSize();
-        if (frame_size != frame.size()) {
-          frame.resize({frame_size}, false);
+    hasPendingFrame = false;
+    return DecodeIntoArray(upDecoder.get(), frame);
+  }
+
+  /* Decodes up to batch_size frames straight into rows of batch array, which
+   * is reshaped to (batch_size, frame size) only if its shape differs. Frame
+   * timestamps in seconds go to timestamps array. Returns number of frames
+   * decoded, it's less than batch_size at the end of input or if resolution
+   * changes;
+   */
+  size_t DecodeBatch(py::array_t<uint8_t> &batch,
+                     py::array_t<double> &timestamps, size_t batch_size) {
+    auto decoder = upDecoder.get();
+    if (!batch_size) {
+      return 0U;
+    }
+
+    if ((size_t)timestamps.size() != batch_size) {
+      timestamps.resize({batch_size}, false);
+    }
+
+    // First frame of batch tells its size, unless batch is already shaped;
+    size_t num_frames = 0U;
+    auto pFrame = (Buffer *)decoder->GetOutput(0U);
+    hasPendingFrame = hasPendingFrame && pFrame;
+    if (!hasPendingFrame &&
+        (2 != batch.ndim() || batch_size != (size_t)batch.shape(0) ||
+         !batch.shape(1))) {
+      py::array_t<uint8_t> frame;
+      if (!DecodeIntoArray(decoder, frame)) {
+        return 0U;
+      }
+      pFrame = (Buffer *)decoder->GetOutput(0U);
+      hasPendingFrame = true;
+    }
+
+    if (hasPendingFrame) {
+      auto const frame_size = pFrame->GetRawMemSize();
+      if (2 != batch.ndim() || batch_size != (size_t)batch.shape(0) ||
+          frame_size != (size_t)batch.shape(1)) {
+        batch.resize({batch_size, frame_size}, false);
+      }
+
+      memcpy(batch.mutable_data(), pFrame->GetRawMemPtr(), frame_size);
+      timestamps.mutable_data()[0] = decoder->GetTimestamp();
+      hasPendingFrame = false;
+      num_frames = 1U;
+    }
+
+    // The rest of frames is decoded in place without GIL;
+    auto const row_size = (size_t)batch.shape(1);
+    auto pBatch = batch.mutable_data();
+    auto pTimestamps = timestamps.mutable_data();
+    auto const res = RunBlocking([&]() {
+      unique_ptr<Buffer> dst(Buffer::Make(row_size, pBatch));
+      auto status = TASK_EXEC_SUCCESS;
+      for (; num_frames < batch_size; num_frames++) {
+        dst->Update(row_size, pBatch + num_frames * row_size);
+        decoder->SetInput((Token *)dst.get(), 0U);
+        status = decoder->Execute();
+
+        auto pRawFrame = (Buffer *)decoder->GetOutput(0U);
+        if (TASK_EXEC_SUCCESS != status || !pRawFrame) {
+          break;
+        } else if (pRawFrame != dst.get()) {
+          // Frame size has changed, next batch starts with this frame;
+          hasPendingFrame = true;
+          break;
         }
+        pTimestamps[num_frames] = decoder->GetTimestamp();
+      }
+      decoder->SetInput(nullptr, 0U);
+
+      // Frames decoded before timeout are given away;
+      return num_frames ? TASK_EXEC_SUCCESS : status;
+    });
+
+    /* Batch was shaped for another frame size, e. g. when it's reused for
+     * other input. Nothing is written yet, so it's reshaped for this frame;
+     */
+    if (!num_frames && hasPendingFrame) {
+      return DecodeBatch(batch, timestamps, batch_size);
+    }
 
-        memcpy(frame.mutable_data(), pRawFrame->GetRawMemPtr(), frame_size);
-        return true;
+    return TASK_EXEC_SUCCESS == res ? num_frames : 0U;
+  }
+
+  void SetSkipOptions(const map<string, string> &options) {
+    upDecoder->SetSkipOptions(options);
+  }
+
+  /* Returns frames shown at given timestamps in seconds, one per timestamp;
+   * Empty array is returned for those which couldn't be decoded;
+   */
+  py::list SampleFrames(const vector<double> &timestamps) {
+    vector<size_t> frame_sizes;
+    auto decoder = upDecoder.get();
+    hasPendingFrame = false;
+    auto const res = RunBlocking([&]() {
+      return decoder->SampleFrames(timestamps, frame_sizes);
+    });
+
+    py::list frames;
+    auto pSamples = (Buffer *)decoder->GetOutput(0U);
+    auto src = pSamples ? pSamples->GetDataAs<uint8_t>() : nullptr;
+    for (auto frame_size : frame_sizes) {
+      if (TASK_EXEC_SUCCESS != res || !src) {
+        frame_size = 0U;
+      }
+
+      py::array_t<uint8_t> frame({frame_size});
+      if (frame_size) {
+        memcpy(frame.mutable_data(), src, frame_size);
+        src += frame_size;
       }
+      frames.append(frame);
     }
-    return false;
+
+    return frames;
   }
 
   void *GetSideData(AVFrameSideDataType data_type, size_t &raw_size) {
@@ -390,8 +562,306 @@ public:
 
     return move(py::array_t<MotionVector>({0}));
   }
+
+  /* Returns single-element array which describes last decoded frame;
+   * Array is empty if there's no such frame;
+   */
+  py::array_t<FrameMetadata> GetFrameMetadata() {
+    auto pMetadata = (Buffer *)upDecoder->GetOutput(2U);
+    if (!pMetadata) {
+      return move(py::array_t<FrameMetadata>({0}));
+    }
+
+    py::array_t<FrameMetadata> metadata({1});
+    memcpy(metadata.mutable_data(), pMetadata->GetRawMemPtr(),
+           sizeof(FrameMetadata));
+    return move(metadata);
+  }
+
+  void Interrupt() { upDecoder->Interrupt(); }
+
+  Pixel_Format GetPixelFormat() const { return upDecoder->GetPixelFormat(); }
+
+  uint32_t Width() const { return upDecoder->GetWidth(); }
+
+  uint32_t Height() const { return upDecoder->GetHeight(); }
 };
 
+class PyFfmpegParallelDecoder {
+  unique_ptr<FfmpegParallelDecodeFrame> upDecoder = nullptr;
+
+public:
+  PyFfmpegParallelDecoder(const string &pathToFile,
+                          const map<string, string> &ffmpeg_options) {
+    NvDecoderClInterface cli_iface(ffmpeg_options);
+    upDecoder.reset(
+        FfmpegParallelDecodeFrame::Make(pathToFile.c_str(), cli_iface));
+  }
+
+  bool DecodeSingleFrame(py::array_t<uint8_t> &frame) {
+    return DecodeIntoArray(upDecoder.get(), frame);
+  }
+
+  void Interrupt() { upDecoder->Interrupt(); }
+
+  Pixel_Format GetPixelFormat() const { return upDecoder->GetPixelFormat(); }
+
+  uint32_t Width() const { return upDecoder->GetWidth(); }
+
+  uint32_t Height() const { return upDecoder->GetHeight(); }
+};
+
+/* Idle demuxers which are rebound to new inputs;
+ * Demuxers created with pool take segment demuxers from it and give them
+ * back once they're done with them;
+ */
+class PyDemuxerPool {
+  shared_ptr<DemuxerPool> pool;
+
+public:
+  PyDemuxerPool(const map<string, string> &ffmpeg_options, size_t max_idle)
+      : pool(make_shared<DemuxerPool>(ffmpeg_options, max_idle)) {}
+
+  shared_ptr<DemuxerPool> Get() const { return pool; }
+
+  size_t NumIdle() const { return pool->GetNumIdle(); }
+};
+
+class PyFFmpegDemuxer {
+  unique_ptr<DemuxFrame> upDemuxer;
+
+public:
+  PyFFmpegDemuxer(const string &pathToFile)
+      : PyFFmpegDemuxer(pathToFile, map<string, string>()) {}
+
+  PyFFmpegDemuxer(const string &pathToFile,
+                  const map<string, string> &ffmpeg_options)
+      : PyFFmpegDemuxer(vector<string>(1U, pathToFile), ffmpeg_options) {}
+
+  // Segments are demuxed as single stream with continuous timestamps;
+  PyFFmpegDemuxer(const vector<string> &segments,
+                  const map<string, string> &ffmpeg_options) {
+    vector<const char *> options;
+    for (auto &pair : ffmpeg_options) {
+      options.push_back(pair.first.c_str());
+      options.push_back(pair.second.c_str());
+    }
+    upDemuxer.reset(
+        DemuxFrame::Make(segments, options.data(), options.size()));
+  }
+
+  PyFFmpegDemuxer(const string &pathToFile, const PyDemuxerPool &pool)
+      : PyFFmpegDemuxer(vector<string>(1U, pathToFile), pool) {}
+
+  PyFFmpegDemuxer(const vector<string> &segments, const PyDemuxerPool &pool) {
+    upDemuxer.reset(DemuxFrame::Make(segments, pool.Get()));
+  }
+
+  uint32_t SegmentIndex() const { return upDemuxer->GetSegmentIndex(); }
+
+  /* Binds demuxer to new input with same options;
+   * Reuses buffers and skips global FFmpeg initialization, so it's cheaper
+   * than creating new demuxer for every short input;
+   */
+  void Reopen(const string &pathToFile) {
+    upDemuxer->Reopen(vector<string>(1U, pathToFile));
+  }
+
+  void ReopenPlaylist(const vector<string> &segments) {
+    upDemuxer->Reopen(segments);
+  }
+
+  /* Seeks to keyframe at or before given timestamp in seconds;
+   * Returns true in case of success, false otherwise;
+   */
+  bool Seek(double timestamp) {
+    py::gil_scoped_release release;
+    return upDemuxer->Seek(timestamp);
+  }
+
+  /* Demuxes single video packet to numpy array;
+   * Returns true in case of success, false otherwise;
+   */
+  bool DemuxSinglePacket(py::array_t<uint8_t> &packet) {
+    auto demuxer = upDemuxer.get();
+    if (TASK_EXEC_SUCCESS !=
+        RunBlocking([demuxer]() { return demuxer->Execute(); })) {
+      return false;
+    }
+
+    auto elementaryVideo = (Buffer *)upDemuxer->GetOutput(0U);
+    if (!elementaryVideo) {
+      return false;
+    }
+
+    auto const packet_size = elementaryVideo->GetRawMemSize();
+    if (packet_size != packet.size()) {
+      packet.resize({packet_size}, false);
+    }
+    memcpy(packet.mutable_data(), elementaryVideo->GetRawMemPtr(),
+           packet_size);
+    return true;
+  }
+
+  /* Demuxes multiple video packets to numpy arrays;
+   * First array gets packets stored back to back, second array gets their
+   * offsets, sizes, timestamps and flags;
+   * Returns true in case of success, false otherwise;
+   */
+  bool DemuxBatch(py::array_t<uint8_t> &packets,
+                  py::array_t<PacketBatchEntry> &entries, uint32_t num_packets,
+                  size_t byte_budget) {
+    auto demuxer = upDemuxer.get();
+    if (TASK_EXEC_SUCCESS != RunBlocking([=]() {
+          return demuxer->DemuxBatch(num_packets, byte_budget);
+        })) {
+      return false;
+    }
+
+    auto elementaryVideo = (Buffer *)upDemuxer->GetOutput(0U);
+    auto batchEntries = (Buffer *)upDemuxer->GetOutput(2U);
+    if (!elementaryVideo || !batchEntries) {
+      return false;
+    }
+
+    auto const packets_size = elementaryVideo->GetRawMemSize();
+    if (packets_size != packets.size()) {
+      packets.resize({packets_size}, false);
+    }
+    memcpy(packets.mutable_data(), elementaryVideo->GetRawMemPtr(),
+           packets_size);
+
+    auto const num_entries =
+        batchEntries->GetRawMemSize() / sizeof(PacketBatchEntry);
+    if (num_entries != entries.size()) {
+      entries.resize({num_entries}, false);
+    }
+    memcpy(entries.mutable_data(), batchEntries->GetRawMemPtr(),
+           num_entries * sizeof(PacketBatchEntry));
+
+    return true;
+  }
+
+  /* Demuxes next packet of non-video stream selected with "streams" option;
+   * Video and other streams packets which are read meanwhile are queued;
+   */
+  bool DemuxStreamPacket(uint32_t stream_index, py::array_t<uint8_t> &packet) {
+    auto demuxer = upDemuxer.get();
+    if (TASK_EXEC_SUCCESS != RunBlocking([=]() {
+          return demuxer->DemuxStream(stream_index);
+        })) {
+      return false;
+    }
+
+    auto streamPacket = (Buffer *)upDemuxer->GetOutput(3U);
+    if (!streamPacket) {
+      return false;
+    }
+
+    auto const packet_size = streamPacket->GetRawMemSize();
+    if (packet_size != packet.size()) {
+      packet.resize({packet_size}, false);
+    }
+    memcpy(packet.mutable_data(), streamPacket->GetRawMemPtr(), packet_size);
+
+    return true;
+  }
+
+  vector<int> ExtraStreams() const { return upDemuxer->GetExtraStreams(); }
+
+  void Interrupt() { upDemuxer->Interrupt(); }
+
+  void LastPacketData(PacketData &packetData) const {
+    auto mp_buffer = (Buffer *)upDemuxer->GetOutput(1U);
+    if (mp_buffer) {
+      auto mp = mp_buffer->GetDataAs<MuxingParams>();
+      packetData = mp->videoContext.packetData;
+    }
+  }
+
+  void LastAudioContext(AudioContext &audioContext) const {
+    auto mp_buffer = (Buffer *)upDemuxer->GetOutput(1U);
+    if (mp_buffer) {
+      auto mp = mp_buffer->GetDataAs<MuxingParams>();
+      audioContext = mp->audioContext;
+    }
+  }
+
+  uint32_t Width() const {
+    MuxingParams params;
+    upDemuxer->GetParams(params);
+    return params.videoContext.width;
+  }
+
+  uint32_t Height() const {
+    MuxingParams params;
+    upDemuxer->GetParams(params);
+    return params.videoContext.height;
+  }
+
+  double Framerate() const {
+    MuxingParams params;
+    upDemuxer->GetParams(params);
+    return params.videoContext.frameRate;
+  }
+
+  double Timebase() const {
+    MuxingParams params;
+    upDemuxer->GetParams(params);
+    return params.videoContext.timeBase;
+  }
+};
+
+class PyStreamCopyTrimmer {
+  unique_ptr<StreamCopyTrimmer> upTrimmer;
+
+public:
+  PyStreamCopyTrimmer(const string &input, const string &output,
+                      const map<string, string> &ffmpeg_options) {
+    upTrimmer.reset(
+        new StreamCopyTrimmer(input.c_str(), output.c_str(), ffmpeg_options));
+  }
+
+  /* Copies [start, end) range to output starting from keyframe at or before
+   * start; Returns number of written packets;
+   */
+  uint32_t Trim(double start, double end) {
+    py::gil_scoped_release release;
+    return upTrimmer->Trim(start, end);
+  }
+
+  /* Frame-accurate version, re-encodes leading GOP on given GPU;
+   * Returns number of written packets;
+   */
+  uint32_t TrimReencode(double start, double end, int gpuOrdinal,
+                        const map<string, string> &enc_options) {
+    if (gpuOrdinal < 0 || gpuOrdinal >= CudaResMgr::Instance().GetNumGpus()) {
+      gpuOrdinal = 0U;
+    }
+
+    py::gil_scoped_release release;
+    return upTrimmer->TrimReencode(start, end,
+                                   CudaResMgr::Instance().GetCtx(gpuOrdinal),
+                                   CudaResMgr::Instance().GetStream(gpuOrdinal),
+                                   enc_options);
+  }
+};
+
+/* Gathers video bitstream statistics in single pass over packets;
+ * Length-prefixed packets are kept as is unless "annexb" option says
+ * otherwise, so packet sizes match container;
+ */
+static BitstreamStats CollectBitstreamStats(
+    const string &pathToFile, const map<string, string> &ffmpeg_options,
+    double window) {
+  auto options = ffmpeg_options;
+  options.emplace("annexb", "0");
+
+  py::gil_scoped_release release;
+  FFmpegDemuxer demuxer(pathToFile.c_str(), options);
+  return BitstreamStatsCollector::Collect(demuxer, window);
+}
+
 class HwResetException : public runtime_error {
 public:
   HwResetException(string &str) : runtime_error(str) {}
@@ -410,6 +880,14 @@ public:
       : PyNvDecoder(pathToFile, gpuOrdinal, map<string, string>()) {}
 
   PyNvDecoder(const string &pathToFile, int gpuOrdinal,
+              const map<string, string> &ffmpeg_options)
+      : PyNvDecoder(vector<string>(1U, pathToFile), gpuOrdinal,
+                    ffmpeg_options) {}
+
+  /* Segments are decoded as single stream, so decoder isn't re-created at
+   * segments boundaries;
+   */
+  PyNvDecoder(const vector<string> &segments, int gpuOrdinal,
               const map<string, string> &ffmpeg_options) {
     if (gpuOrdinal < 0 || gpuOrdinal >= CudaResMgr::Instance().GetNumGpus()) {
       gpuOrdinal = 0U;
@@ -423,7 +901,7 @@ public:
       options.push_back(pair.second.c_str());
     }
     upDemuxer.reset(
-        DemuxFrame::Make(pathToFile.c_str(), options.data(), options.size()));
+        DemuxFrame::Make(segments, options.data(), options.size()));
 
     MuxingParams params;
     upDemuxer->GetParams(params);
@@ -443,7 +921,8 @@ public:
      * it until we get elementary video;
      */
     do {
-      if (TASK_EXEC_FAIL == demuxer->Execute()) {
+      if (TASK_EXEC_FAIL ==
+          RunBlocking([demuxer]() { return demuxer->Execute(); })) {
         return nullptr;
       }
       elementaryVideo = (Buffer *)demuxer->GetOutput(0U);
@@ -511,6 +990,9 @@ public:
     return output != nullptr;
   }
 
+  // Aborts blocking demuxer I/O, may be called from any thread;
+  void Interrupt() { upDemuxer->Interrupt(); }
+
   uint32_t Width() const {
     MuxingParams params;
     upDemuxer->GetParams(params);
@@ -805,8 +1287,26 @@ PYBIND11_MODULE(PyNvCodec, m) {
 
   py::class_<MotionVector>(m, "MotionVector");
 
+  PYBIND11_NUMPY_DTYPE_EX(PacketBatchEntry, offset, "offset", size, "size",
+                          pts, "pts", dts, "dts", duration, "duration", flags,
+                          "flags");
+
+  py::class_<PacketBatchEntry>(m, "PacketBatchEntry");
+
+  PYBIND11_NUMPY_DTYPE_EX(
+      FrameMetadata, pts, "pts", pkt_dts, "pkt_dts", best_effort_timestamp,
+      "best_effort_timestamp", duration, "duration", time_base_num,
+      "time_base_num", time_base_den, "time_base_den", width, "width", height,
+      "height", pict_type, "pict_type", repeat_pict, "repeat_pict", key_frame,
+      "key_frame", interlaced_frame, "interlaced_frame", top_field_first,
+      "top_field_first");
+
+  py::class_<FrameMetadata>(m, "FrameMetadata");
+
   py::register_exception<HwResetException>(m, "HwResetException");
 
+  py::register_exception<TimeoutException>(m, "TimeoutException");
+
   py::enum_<Pixel_Format>(m, "PixelFormat")
       .value("Y", Pixel_Format::Y)
       .value("RGB", Pixel_Format::RGB)
@@ -815,9 +1315,20 @@ PYBIND11_MODULE(PyNvCodec, m) {
       .value("RGB_PLANAR", Pixel_Format::RGB_PLANAR)
       .value("BGR", Pixel_Format::BGR)
       .value("YCBCR", Pixel_Format::YCBCR)
+      .value("YUV422", Pixel_Format::YUV422)
+      .value("YUV444", Pixel_Format::YUV444)
+      .value("P10", Pixel_Format::P10)
+      .value("YUV420_10bit", Pixel_Format::YUV420_10bit)
       .value("UNDEFINED", Pixel_Format::UNDEFINED)
       .export_values();
 
+  // Not exported to module scope as single-letter names would clash;
+  py::enum_<SliceType>(m, "SliceType")
+      .value("UNKNOWN", SliceType::SLICE_TYPE_UNKNOWN)
+      .value("I", SliceType::SLICE_TYPE_I)
+      .value("P", SliceType::SLICE_TYPE_P)
+      .value("B", SliceType::SLICE_TYPE_B);
+
   py::class_<SurfacePlane, shared_ptr<SurfacePlane>>(m, "SurfacePlane")
       .def("Width", &SurfacePlane::Width)
       .def("Height", &SurfacePlane::Height)
@@ -892,19 +1403,127 @@ PYBIND11_MODULE(PyNvCodec, m) {
   py::class_<PyFfmpegDecoder>(m, "PyFfmpegDecoder")
       .def(py::init<const string &, const map<string, string> &>())
       .def("DecodeSingleFrame", &PyFfmpegDecoder::DecodeSingleFrame)
+      .def("DecodeBatch", &PyFfmpegDecoder::DecodeBatch, py::arg("batch"),
+           py::arg("timestamps"), py::arg("batch_size"))
+      .def("SetSkipOptions", &PyFfmpegDecoder::SetSkipOptions)
+      .def("SampleFrames", &PyFfmpegDecoder::SampleFrames)
       .def("GetMotionVectors", &PyFfmpegDecoder::GetMotionVectors,
-           py::return_value_policy::move);
+           py::return_value_policy::move)
+      .def("GetFrameMetadata", &PyFfmpegDecoder::GetFrameMetadata,
+           py::return_value_policy::move)
+      .def("Interrupt", &PyFfmpegDecoder::Interrupt)
+      .def("Format", &PyFfmpegDecoder::GetPixelFormat)
+      .def("Width", &PyFfmpegDecoder::Width)
+      .def("Height", &PyFfmpegDecoder::Height);
+
+  py::class_<PyFfmpegParallelDecoder>(m, "PyFfmpegParallelDecoder")
+      .def(py::init<const string &, const map<string, string> &>())
+      .def("DecodeSingleFrame", &PyFfmpegParallelDecoder::DecodeSingleFrame)
+      .def("Interrupt", &PyFfmpegParallelDecoder::Interrupt)
+      .def("Format", &PyFfmpegParallelDecoder::GetPixelFormat)
+      .def("Width", &PyFfmpegParallelDecoder::Width)
+      .def("Height", &PyFfmpegParallelDecoder::Height);
 
   py::class_<PacketData>(m, "PacketData")
       .def(py::init<>())
       .def_readonly("pts", &PacketData::pts)
       .def_readonly("dts", &PacketData::dts)
       .def_readonly("pos", &PacketData::pos)
-      .def_readonly("duration", &PacketData::duration);
+      .def_readonly("duration", &PacketData::duration)
+      .def_readonly("flags", &PacketData::flags)
+      .def_readonly("nal_types", &PacketData::nalTypes)
+      .def_readonly("slice_type", &PacketData::sliceType)
+      .def_readonly("nal_ref_idc", &PacketData::nalRefIdc)
+      .def_readonly("temporal_id", &PacketData::temporalId)
+      .def_readonly("is_idr", &PacketData::isIDR)
+      .def_readonly("is_reference", &PacketData::isReference)
+      .def_readonly("has_vps", &PacketData::hasVPS)
+      .def_readonly("has_sps", &PacketData::hasSPS)
+      .def_readonly("has_pps", &PacketData::hasPPS);
+
+  py::class_<AudioContext>(m, "AudioContext")
+      .def(py::init<>())
+      .def_readonly("stream_index", &AudioContext::streamIndex)
+      .def_readonly("codec_id", &AudioContext::codecId)
+      .def_readonly("sample_format", &AudioContext::sampleFormat)
+      .def_readonly("sample_rate", &AudioContext::sampleRate)
+      .def_readonly("num_channels", &AudioContext::numChannels)
+      .def_readonly("channel_layout", &AudioContext::channelLayout)
+      .def_readonly("time_base", &AudioContext::timeBase)
+      .def_readonly("packet_data", &AudioContext::packetData);
+
+  py::class_<BitstreamStats>(m, "BitstreamStats")
+      .def_readonly("num_packets", &BitstreamStats::numPackets)
+      .def_readonly("num_keyframes", &BitstreamStats::numKeyframes)
+      .def_readonly("total_bytes", &BitstreamStats::totalBytes)
+      .def_readonly("duration", &BitstreamStats::duration)
+      .def_readonly("avg_bitrate", &BitstreamStats::avgBitrate)
+      .def_readonly("max_bitrate", &BitstreamStats::maxBitrate)
+      .def_readonly("min_gop_size", &BitstreamStats::minGopSize)
+      .def_readonly("max_gop_size", &BitstreamStats::maxGopSize)
+      .def_readonly("avg_gop_size", &BitstreamStats::avgGopSize)
+      .def_readonly("min_keyframe_interval",
+                    &BitstreamStats::minKeyframeInterval)
+      .def_readonly("max_keyframe_interval",
+                    &BitstreamStats::maxKeyframeInterval)
+      .def_readonly("avg_keyframe_interval",
+                    &BitstreamStats::avgKeyframeInterval)
+      .def_readonly("num_idr", &BitstreamStats::numIDR)
+      .def_readonly("num_i", &BitstreamStats::numI)
+      .def_readonly("num_p", &BitstreamStats::numP)
+      .def_readonly("num_b", &BitstreamStats::numB)
+      .def_readonly("max_consecutive_b", &BitstreamStats::maxConsecutiveB)
+      .def_readonly("window", &BitstreamStats::window)
+      .def_readonly("bitrate", &BitstreamStats::bitrate)
+      .def_readonly("gop_sizes", &BitstreamStats::gopSizes)
+      .def_readonly("size_histogram", &BitstreamStats::sizeHistogram);
+
+  py::class_<PyDemuxerPool>(m, "PyDemuxerPool")
+      .def(py::init<const map<string, string> &, size_t>(),
+           py::arg("ffmpeg_options") = map<string, string>(),
+           py::arg("max_idle") = 8U)
+      .def("NumIdle", &PyDemuxerPool::NumIdle);
+
+  py::class_<PyFFmpegDemuxer>(m, "PyFFmpegDemuxer")
+      .def(py::init<const string &, const map<string, string> &>())
+      .def(py::init<const string &>())
+      .def(py::init<const vector<string> &, const map<string, string> &>())
+      .def(py::init<const string &, const PyDemuxerPool &>())
+      .def(py::init<const vector<string> &, const PyDemuxerPool &>())
+      .def("SegmentIndex", &PyFFmpegDemuxer::SegmentIndex)
+      .def("Reopen", &PyFFmpegDemuxer::Reopen)
+      .def("Reopen", &PyFFmpegDemuxer::ReopenPlaylist)
+      .def("Width", &PyFFmpegDemuxer::Width)
+      .def("Height", &PyFFmpegDemuxer::Height)
+      .def("Framerate", &PyFFmpegDemuxer::Framerate)
+      .def("Timebase", &PyFFmpegDemuxer::Timebase)
+      .def("LastPacketData", &PyFFmpegDemuxer::LastPacketData)
+      .def("DemuxSinglePacket", &PyFFmpegDemuxer::DemuxSinglePacket)
+      .def("DemuxBatch", &PyFFmpegDemuxer::DemuxBatch, py::arg("packets"),
+           py::arg("entries"), py::arg("num_packets"),
+           py::arg("byte_budget") = numeric_limits<size_t>::max())
+      .def("DemuxStreamPacket", &PyFFmpegDemuxer::DemuxStreamPacket,
+           py::arg("stream_index"), py::arg("packet"))
+      .def("ExtraStreams", &PyFFmpegDemuxer::ExtraStreams)
+      .def("LastAudioContext", &PyFFmpegDemuxer::LastAudioContext)
+      .def("Seek", &PyFFmpegDemuxer::Seek)
+      .def("Interrupt", &PyFFmpegDemuxer::Interrupt);
+
+  py::class_<PyStreamCopyTrimmer>(m, "PyStreamCopyTrimmer")
+      .def(py::init<const string &, const string &,
+                    const map<string, string> &>(),
+           py::arg("input"), py::arg("output"),
+           py::arg("ffmpeg_options") = map<string, string>())
+      .def("Trim", &PyStreamCopyTrimmer::Trim, py::arg("start"),
+           py::arg("end"))
+      .def("TrimReencode", &PyStreamCopyTrimmer::TrimReencode,
+           py::arg("start"), py::arg("end"), py::arg("gpu_id"),
+           py::arg("encoder_options") = map<string, string>());
 
   py::class_<PyNvDecoder>(m, "PyNvDecoder")
       .def(py::init<const string &, int, const map<string, string> &>())
       .def(py::init<const string &, int>())
+      .def(py::init<const vector<string> &, int, const map<string, string> &>())
       .def("Width", &PyNvDecoder::Width)
       .def("Height", &PyNvDecoder::Height)
       .def("LastPacketData", &PyNvDecoder::LastPacketData)
@@ -914,7 +1533,8 @@ PYBIND11_MODULE(PyNvCodec, m) {
       .def("Format", &PyNvDecoder::GetPixelFormat)
       .def("DecodeSingleSurface", &PyNvDecoder::DecodeSingleSurface,
            py::return_value_policy::take_ownership)
-      .def("DecodeSingleFrame", &PyNvDecoder::DecodeSingleFrame);
+      .def("DecodeSingleFrame", &PyNvDecoder::DecodeSingleFrame)
+      .def("Interrupt", &PyNvDecoder::Interrupt);
 
   py::class_<PyFrameUploader>(m, "PyFrameUploader")
       .def(py::init<uint32_t, uint32_t, Pixel_Format, uint32_t>())
@@ -941,4 +1561,7 @@ PYBIND11_MODULE(PyNvCodec, m) {
            py::return_value_policy::take_ownership);
 
   m.def("GetNumGpus", &CudaResMgr::GetNumGpus);
+  m.def("CollectBitstreamStats", &CollectBitstreamStats, py::arg("input"),
+        py::arg("ffmpeg_options") = map<string, string>(),
+        py::arg("window") = 1.0);
 }